@@ -36,6 +36,10 @@ extern UART_HandleTypeDef huart1;
 
 /* USER CODE BEGIN Private defines */
 
+// receive in the DMA double buffer mode, the two halves of the RX buffer
+// are the two memory targets of the stream. set to 0 for circular mode.
+#define UART_RX_DOUBLE_BUFFER 0
+
 /* USER CODE END Private defines */
 
 void MX_USART1_UART_Init(void);
@@ -48,8 +52,22 @@ int uart_dma_tx_start(void *hdma, const void *psrc, uint32_t len);
 
 int uart_dma_rx_start(void *hdma, void *pdst, uint32_t len);
 
+int uart_rx_lost(void *hdma);
+
 int uart_dma_abort(void *hdma);
 
+int uart_dma_tx_queue(void *hdma, const void *psrc, uint32_t len);
+
+int uart_dma_tx_abort(void *hdma);
+
+void uart_dma_tx_irq_latch(DMA_HandleTypeDef *hdma);
+
+int uart_dma_rx_dbm_update_progress(void *hdma, uint32_t *out_bytes_left);
+
+int uart_dma_rx_dbm_start(void *hdma, void *pdst, uint32_t len);
+
+int uart_dma_rx_dbm_abort(void *hdma);
+
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
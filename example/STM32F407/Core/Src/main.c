@@ -62,13 +62,13 @@ void SystemClock_Config(void);
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 // callback of STM32 HAL
-void UART_DMA_RxCpltCallback(UART_HandleTypeDef *huart)
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
 {
   if (huart == &huart1)
     auart_dma_rx_cplt_callback(&auart1);
 }
 
-void UART_DMA_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
 {
   if (huart == &huart1)
     auart_dma_rx_half_cplt_callback(&auart1);
@@ -85,6 +85,33 @@ void UART_IdleCallback(UART_HandleTypeDef *huart)
   if (huart == &huart1)
     auart_idle_callback(&auart1);
 }
+
+// sleep until the next interrupt instead of spinning in the main loop
+static int uart_wait_event(void *h_event, uint32_t timeout_ms)
+{
+  __WFI();
+  return 0;
+}
+
+// shared by every port on the same kind of DMA, stays in flash
+static const auart_ops_t uart_ops = {
+    .dma_tx_start = uart_dma_tx_start,
+#if (UART_RX_DOUBLE_BUFFER == 1)
+    .dma_rx_start = uart_dma_rx_dbm_start,
+    .dma_rx_update_progress = uart_dma_rx_dbm_update_progress,
+    .dma_rx_abort = uart_dma_rx_dbm_abort,
+#else
+    .dma_rx_start = uart_dma_rx_start,
+    .dma_rx_update_progress = uart_dma_update_progress,
+    .dma_rx_abort = uart_dma_abort,
+#endif
+    .rx_lost = uart_rx_lost,
+    .dma_tx_update_progress = uart_dma_update_progress,
+    .dma_tx_abort = uart_dma_tx_abort,
+    .dma_tx_queue = uart_dma_tx_queue,
+    .get_tick_ms = HAL_GetTick,
+    .wait_event = uart_wait_event,
+};
 /* USER CODE END 0 */
 
 /**
@@ -118,13 +145,8 @@ int main(void)
   MX_DMA_Init();
   MX_USART1_UART_Init();
   /* USER CODE BEGIN 2 */
-  static auart_init_t auart1_init = {
-      .dma_tx_start = uart_dma_tx_start,
-      .dma_rx_start = uart_dma_rx_start,
-      .dma_rx_update_progress = uart_dma_update_progress,
-      .dma_tx_abort = uart_dma_abort,
-      .dma_rx_abort = uart_dma_abort,
-      .get_tick_ms = HAL_GetTick,
+  auart_init_t auart1_init = {
+      .ops = &uart_ops,
       .h_rxdma = &hdma_usart1_rx,
       .h_txdma = &hdma_usart1_tx,
   };
@@ -142,7 +164,8 @@ int main(void)
   int rx_cnt = 0;
   while (1)
   {
-    res = auart_rx(&auart1, buffer + rx_cnt, 128 - rx_cnt);
+    res = auart_rx_timeout(&auart1, buffer + rx_cnt, 128 - rx_cnt,
+                          AUART_WAIT_FOREVER);
     if (res > 0)
     {
       // echo back
@@ -165,6 +188,12 @@ int main(void)
 
       rx_cnt += res;
     }
+    else if (res == AUART_OVERRUN)
+    {
+      // bytes were lost, the line is garbage
+      rx_cnt = 0;
+      memset(buffer, 0, 128);
+    }
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
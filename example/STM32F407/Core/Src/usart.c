@@ -91,7 +91,7 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle)
     hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
     hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
     hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
-    hdma_usart1_rx.Init.Mode = DMA_NORMAL;
+    hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
     hdma_usart1_rx.Init.Priority = DMA_PRIORITY_LOW;
     hdma_usart1_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
     if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
@@ -189,6 +189,23 @@ int uart_dma_rx_start(void *hdma, void *pdst, uint32_t len)
   return 0;
 }
 
+int uart_rx_lost(void *hdma)
+{
+  if (hdma == NULL)
+    return -1;
+
+  // with the DMA stopped, the first byte waits in DR and the next ones
+  // set ORE. `HAL_UART_Receive_DMA()` clears ORE, so this must be read
+  // before the restart.
+  int is_lost = __HAL_UART_GET_FLAG(&huart1, UART_FLAG_RXNE) ||
+                __HAL_UART_GET_FLAG(&huart1, UART_FLAG_ORE);
+
+  // reading SR then DR clears both
+  __HAL_UART_CLEAR_OREFLAG(&huart1);
+
+  return is_lost;
+}
+
 int uart_dma_tx_start(void *hdma, const void *psrc, uint32_t len)
 {
   if (hdma == NULL || psrc == NULL || len == 0)
@@ -204,6 +221,54 @@ int uart_dma_tx_start(void *hdma, const void *psrc, uint32_t len)
   return 0;
 }
 
+// the transfer queued by `uart_dma_tx_queue()`, started by
+// `uart_dma_tx_irq_latch()` as soon as the running one is complete.
+static const void *volatile tx_latch_src;
+static volatile uint32_t tx_latch_len;
+
+int uart_dma_tx_queue(void *hdma, const void *psrc, uint32_t len)
+{
+  if (hdma == NULL || psrc == NULL || len == 0 || len > 0xFFFF)
+    return -1;
+
+  tx_latch_src = psrc;
+  tx_latch_len = len;
+
+  return 0;
+}
+
+int uart_dma_tx_abort(void *hdma)
+{
+  if (hdma == NULL)
+    return -1;
+
+  tx_latch_len = 0;
+
+  return uart_dma_abort(hdma);
+}
+
+void uart_dma_tx_irq_latch(DMA_HandleTypeDef *hdma)
+{
+  uint32_t len = tx_latch_len;
+
+  if (len == 0 || !__HAL_DMA_GET_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma)))
+    return;
+
+  tx_latch_len = 0;
+
+  // the stream disabled itself at the end of the transfer, it is
+  // reprogrammed before anything else so the line barely idles. the HAL
+  // handler finds the flags cleared and leaves the UART in DMA mode.
+  __HAL_DMA_CLEAR_FLAG(hdma, __HAL_DMA_GET_TC_FLAG_INDEX(hdma) |
+                                 __HAL_DMA_GET_HT_FLAG_INDEX(hdma));
+  hdma->Instance->M0AR = (uint32_t)tx_latch_src;
+  hdma->Instance->NDTR = len;
+  __HAL_DMA_ENABLE(hdma);
+
+  // the first transfer is done, the driver sees the latched one running
+  HAL_UART_TxCpltCallback(&huart1);
+}
+
 int uart_dma_abort(void *hdma)
 {
   if (hdma == NULL)
@@ -220,4 +285,106 @@ int uart_dma_abort(void *hdma)
   return 0;
 }
 
+// in double buffer mode the stream swaps between the two halves of the RX
+// buffer by itself. the end of the first half is reported like a half
+// transfer and the end of the second one like a complete transfer.
+static void uart_dma_rx_m0_cplt(DMA_HandleTypeDef *hdma)
+{
+  HAL_UART_RxHalfCpltCallback(&huart1);
+}
+
+static void uart_dma_rx_m1_cplt(DMA_HandleTypeDef *hdma)
+{
+  HAL_UART_RxCpltCallback(&huart1);
+}
+
+static void uart_dma_rx_error(DMA_HandleTypeDef *hdma)
+{
+  HAL_UART_ErrorCallback(&huart1);
+}
+
+int uart_dma_rx_dbm_update_progress(void *hdma, uint32_t *out_bytes_left)
+{
+  if (hdma == NULL || out_bytes_left == NULL)
+    return -1;
+
+  DMA_Stream_TypeDef *stream = ((DMA_HandleTypeDef *)hdma)->Instance;
+
+  uint32_t half = stream->M1AR - stream->M0AR;
+  uint32_t ct;
+  uint32_t ndtr;
+
+  // the counter reloads when the target swaps, read again until both
+  // belong to the same half.
+  do
+  {
+    ct = stream->CR & DMA_SxCR_CT;
+    ndtr = stream->NDTR;
+  } while ((stream->CR & DMA_SxCR_CT) != ct);
+
+  // bytes left up to the end of the whole buffer
+  *out_bytes_left = ct ? ndtr : half + ndtr;
+
+  return 0;
+}
+
+int uart_dma_rx_dbm_start(void *hdma, void *pdst, uint32_t len)
+{
+  // two halves of the same size, each within the 16 bits of NDTR
+  if (hdma == NULL || pdst == NULL || len == 0 || len % 2 != 0 ||
+      len / 2 > 0xFFFF)
+    return -1;
+
+  DMA_HandleTypeDef *hdma_uart = (DMA_HandleTypeDef *)hdma;
+  uint32_t half = len / 2;
+
+  hdma_uart->XferCpltCallback = uart_dma_rx_m0_cplt;
+  hdma_uart->XferM1CpltCallback = uart_dma_rx_m1_cplt;
+  hdma_uart->XferHalfCpltCallback = NULL;
+  hdma_uart->XferM1HalfCpltCallback = NULL;
+  hdma_uart->XferErrorCallback = uart_dma_rx_error;
+  hdma_uart->XferAbortCallback = NULL;
+
+  // the HAL keeps the target the stream was stopped on, start on M0 so
+  // the data begins at the start of the buffer like the driver expects.
+  CLEAR_BIT(hdma_uart->Instance->CR, DMA_SxCR_CT);
+
+  HAL_StatusTypeDef res = HAL_DMAEx_MultiBufferStart_IT(
+      hdma_uart,
+      (uint32_t)&huart1.Instance->DR,
+      (uint32_t)pdst,
+      (uint32_t)pdst + half,
+      half);
+
+  if (res != HAL_OK)
+    return -1;
+
+  // a byte received before the start would be flagged as an overrun
+  __HAL_UART_CLEAR_OREFLAG(&huart1);
+
+  SET_BIT(huart1.Instance->CR3, USART_CR3_DMAR);
+
+  // enable IDLE interrupt to detect the end of the transfer
+  __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
+
+  return 0;
+}
+
+int uart_dma_rx_dbm_abort(void *hdma)
+{
+  if (hdma == NULL)
+    return -1;
+
+  // not started through the UART driver, `HAL_UART_DMAStop()` would
+  // leave it running.
+  CLEAR_BIT(huart1.Instance->CR3, USART_CR3_DMAR);
+
+  HAL_StatusTypeDef res = HAL_DMA_Abort((DMA_HandleTypeDef *)hdma);
+
+  if (res != HAL_OK)
+    return -1;
+
+  return 0;
+}
+
 /* USER CODE END 1 */
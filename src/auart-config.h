@@ -19,7 +19,11 @@
 
 #ifndef CONFIG_AUART_TX_BUFFER_SIZE
 /**
- * @brief How many bytes should be reserved for the TX buffer
+ * @brief How many bytes should be reserved for the built-in TX buffer
+ *
+ * The built-in buffer is used when `auart_init_t` does not provide one.
+ * Set to 0 to leave it out of `auart_t` when every port brings its own.
+ *
  * @note This value is nice to be a power of 2.
  */
 #define CONFIG_AUART_TX_BUFFER_SIZE 128
@@ -27,12 +31,41 @@
 
 #ifndef CONFIG_AUART_RX_BUFFER_SIZE
 /**
- * @brief How many bytes should be reserved for the RX buffer
+ * @brief How many bytes should be reserved for the built-in RX buffer
+ *
+ * The built-in buffer is used when `auart_init_t` does not provide one.
+ * Set to 0 to leave it out of `auart_t` when every port brings its own.
+ *
  * @note This value is nice to be a power of 2.
  */
 #define CONFIG_AUART_RX_BUFFER_SIZE 1024
 #endif // !#ifndef CONFIG_AUART_RX_BUFFER_SIZE
 
+#ifndef CONFIG_AUART_MAX_BUFFER_SIZE
+/**
+ * @brief The size of the largest TX or RX buffer of any port.
+ *
+ * Selects the width of the indices kept in `auart_t`: 8 bits up to 128
+ * bytes and 16 bits up to 32 KB, the indices count up to twice the size
+ * of the buffer. Narrow indices save RAM and keep every shared index a
+ * single byte or halfword access on small cores.
+ * `auart_init()` rejects larger buffers.
+ *
+ * Set to 0 to allow any size, with 32-bit indices.
+ */
+#define CONFIG_AUART_MAX_BUFFER_SIZE 0
+#endif // !#ifndef CONFIG_AUART_MAX_BUFFER_SIZE
+
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_TX_BUFFER_SIZE > CONFIG_AUART_MAX_BUFFER_SIZE)
+#error "CONFIG_AUART_TX_BUFFER_SIZE must not exceed CONFIG_AUART_MAX_BUFFER_SIZE"
+#endif
+
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_RX_BUFFER_SIZE > CONFIG_AUART_MAX_BUFFER_SIZE)
+#error "CONFIG_AUART_RX_BUFFER_SIZE must not exceed CONFIG_AUART_MAX_BUFFER_SIZE"
+#endif
+
 #ifndef CONFIG_AUART_USE_TIME_API
 /**
  * @brief Whether to use the time API or not.
@@ -41,6 +74,218 @@
 #define CONFIG_AUART_USE_TIME_API 1
 #endif // !#ifndef CONFIG_AUART_USE_TIME_API
 
+#ifndef CONFIG_AUART_TX_COALESCE_MIN_SIZE
+/**
+ * @brief How many bytes should be collected before the TX DMA is started.
+ *
+ * Small writes arriving while the TX DMA is idle are held back until at
+ * least this many bytes are pending, so they go out in a single transfer
+ * with a single complete interrupt. Data committed while a transfer is
+ * running is always sent as soon as that transfer completes.
+ *
+ * Set to 0 to start the DMA on every write.
+ *
+ * @note `auart_tx_kick()` sends the held bytes immediately.
+ */
+#define CONFIG_AUART_TX_COALESCE_MIN_SIZE 0
+#endif // !#ifndef CONFIG_AUART_TX_COALESCE_MIN_SIZE
+
+#ifndef CONFIG_AUART_TX_COALESCE_HOLD_MS
+/**
+ * @brief How long, in milliseconds, small writes can be held back by
+ * CONFIG_AUART_TX_COALESCE_MIN_SIZE.
+ *
+ * The hold time is checked whenever data is committed to the TX buffer
+ * and by `auart_tick()`. It is only a maximum if `auart_tick()` is called
+ * periodically: without it, the last small write waits for the next
+ * commit, however long that takes. With `auart_tick()` called every T
+ * milliseconds, the data is held back at most this long plus T.
+ * Set to 0 to hold the data until enough bytes are pending or
+ * `auart_tx_kick()` is called.
+ *
+ * @note requires CONFIG_AUART_USE_TIME_API and a periodic `auart_tick()`.
+ */
+#define CONFIG_AUART_TX_COALESCE_HOLD_MS 0
+#endif // !#ifndef CONFIG_AUART_TX_COALESCE_HOLD_MS
+
+#if (CONFIG_AUART_TX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_TX_COALESCE_MIN_SIZE >= CONFIG_AUART_TX_BUFFER_SIZE)
+#error "CONFIG_AUART_TX_COALESCE_MIN_SIZE must be less than the TX buffer size"
+#endif
+
+#if (CONFIG_AUART_TX_COALESCE_HOLD_MS > 0) && (CONFIG_AUART_USE_TIME_API != 1)
+#error "CONFIG_AUART_TX_COALESCE_HOLD_MS requires CONFIG_AUART_USE_TIME_API"
+#endif
+
+#ifndef CONFIG_AUART_TX_MULTI_PRODUCER
+/**
+ * @brief Whether several contexts may write to the TX buffer at the same
+ * time.
+ *
+ * If set to 1, `auart_tx()`, `auart_txv()` and `auart_tx_from_isr()` can
+ * be called from the main loop and from any number of interrupts without
+ * a critical section. Each writer claims its own range of the TX buffer,
+ * and the DMA only sends the data once every writer that claimed before
+ * has finished filling its range.
+ *
+ * @note `auart_tx_reserve()` and `auart_tx_commit()` are not available in
+ * this mode.
+ */
+#define CONFIG_AUART_TX_MULTI_PRODUCER 0
+#endif // !#ifndef CONFIG_AUART_TX_MULTI_PRODUCER
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1) && \
+    (CONFIG_AUART_TX_COALESCE_MIN_SIZE > 0)
+#error "CONFIG_AUART_TX_COALESCE_MIN_SIZE requires a single TX producer"
+#endif
+
+#ifndef CONFIG_AUART_TX_DEFERRED_KICK
+/**
+ * @brief Whether the TX DMA is started from a deferred handler.
+ *
+ * If set to 1, the writers and `auart_tx_cplt_callback()` never call
+ * `dma_tx_start()` themselves. They only request the `pend_deferred()`
+ * callback, usually by pending a low priority software interrupt such as
+ * PendSV, and `auart_deferred_handler()` starts the DMA from there. This
+ * keeps the slow HAL calls out of the DMA interrupt.
+ */
+#define CONFIG_AUART_TX_DEFERRED_KICK 0
+#endif // !#ifndef CONFIG_AUART_TX_DEFERRED_KICK
+
+#ifndef CONFIG_AUART_RX_FRAME_QUEUE_SIZE
+/**
+ * @brief How many received frames can be queued for `auart_rx_frame()`.
+ *
+ * A frame is a burst of bytes terminated by an idle line. Bursts longer
+ * than half of the RX buffer are split at the DMA half and complete
+ * events.
+ *
+ * Set to 0 to disable the frame queue.
+ */
+#define CONFIG_AUART_RX_FRAME_QUEUE_SIZE 0
+#endif // !#ifndef CONFIG_AUART_RX_FRAME_QUEUE_SIZE
+
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > CONFIG_AUART_MAX_BUFFER_SIZE)
+#error "CONFIG_AUART_RX_FRAME_QUEUE_SIZE must not exceed CONFIG_AUART_MAX_BUFFER_SIZE"
+#endif
+
+#define AUART_RX_OVERRUN_OVERWRITE_OLDEST 0
+#define AUART_RX_OVERRUN_DROP_NEWEST 1
+#define AUART_RX_OVERRUN_FLOW_CONTROL 2
+
+#ifndef CONFIG_AUART_RX_OVERRUN_POLICY
+/**
+ * @brief What happens when the reader falls behind the RX DMA.
+ *
+ * - AUART_RX_OVERRUN_OVERWRITE_OLDEST: the DMA keeps running over the
+ *   unread data, the overwritten bytes are skipped.
+ * - AUART_RX_OVERRUN_DROP_NEWEST: the RX DMA is stopped once the buffer
+ *   could not take another half of it, the unread data is kept and the
+ *   bytes received meanwhile are dropped. RX restarts once the reader has
+ *   emptied the buffer.
+ * - AUART_RX_OVERRUN_FLOW_CONTROL: the sender is paused with the
+ *   `rx_flow()` callback at the same point, and resumed once the buffer
+ *   is down to a quarter.
+ *
+ * The DMA half and complete events are the only points where the driver
+ * sees the buffer filling, hence the half buffer margin. A sender that
+ * does not stop in time still overwrites the oldest data.
+ *
+ * In every case the RX functions return AUART_OVERRUN once after bytes
+ * have been lost, so parsers can resynchronize. They read the DMA counter
+ * again after copying, so data overwritten between two interrupts is
+ * reported as well, provided the interrupts see every half of the buffer.
+ * The bytes dropped while AUART_RX_OVERRUN_DROP_NEWEST has the DMA stopped
+ * are only reported if the port implements `rx_lost()`.
+ */
+#define CONFIG_AUART_RX_OVERRUN_POLICY AUART_RX_OVERRUN_OVERWRITE_OLDEST
+#endif // !#ifndef CONFIG_AUART_RX_OVERRUN_POLICY
+
+#ifndef CONFIG_AUART_RX_POLL_DMA
+/**
+ * @brief Whether the RX functions read the DMA counter themselves.
+ *
+ * Set to 1 and the bytes are seen by `auart_rx()` and its friends as soon
+ * as the DMA has written them, instead of on the next IDLE, half or
+ * complete interrupt. Costs a `dma_rx_update_progress()` call per read.
+ * A stream without idle gaps is otherwise only seen half a buffer at a
+ * time.
+ */
+#define CONFIG_AUART_RX_POLL_DMA 0
+#endif // !#ifndef CONFIG_AUART_RX_POLL_DMA
+
+#ifndef CONFIG_AUART_TICK_LATENCY_MS
+/**
+ * @brief How often, in milliseconds, `auart_tick()` looks at the RX DMA.
+ *
+ * The bytes received without an IDLE, half or complete interrupt are
+ * announced by `notify_event()` at most this long after they arrived,
+ * given `auart_tick()` is called at least as often. Calls in between
+ * return right away.
+ *
+ * Set to 0 to look at every call.
+ *
+ * @note requires CONFIG_AUART_USE_TIME_API.
+ */
+#define CONFIG_AUART_TICK_LATENCY_MS 0
+#endif // !#ifndef CONFIG_AUART_TICK_LATENCY_MS
+
+#if (CONFIG_AUART_TICK_LATENCY_MS > 0) && (CONFIG_AUART_USE_TIME_API != 1)
+#error "CONFIG_AUART_TICK_LATENCY_MS requires CONFIG_AUART_USE_TIME_API"
+#endif
+
+#ifndef CONFIG_AUART_STATS
+/**
+ * @brief Whether each port keeps the counters read by `auart_get_stats()`.
+ *
+ * Set to 0 to compile the counters out, they take no RAM and no cycles.
+ */
+#define CONFIG_AUART_STATS 0
+#endif // !#ifndef CONFIG_AUART_STATS
+
+#ifndef CONFIG_AUART_USE_C11_ATOMICS
+/**
+ * @brief Whether to use C11 <stdatomic.h> for the indices shared between
+ * the thread and the IRQ context.
+ *
+ * Detected from the compiler by default. If set to 0, the indices are
+ * plain volatile variables ordered by CONFIG_AUART_COMPILER_BARRIER, which
+ * is enough on single core Cortex-M parts without a data cache.
+ */
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+    !defined(__STDC_NO_ATOMICS__)
+#define CONFIG_AUART_USE_C11_ATOMICS 1
+#else
+#define CONFIG_AUART_USE_C11_ATOMICS 0
+#endif
+#endif // !#ifndef CONFIG_AUART_USE_C11_ATOMICS
+
+#ifndef CONFIG_AUART_COMPILER_BARRIER
+/**
+ * @brief Keep the compiler from moving memory accesses across this point.
+ *
+ * Only used when CONFIG_AUART_USE_C11_ATOMICS is 0.
+ */
+#define CONFIG_AUART_COMPILER_BARRIER() __asm__ volatile("" ::: "memory")
+#endif // !#ifndef CONFIG_AUART_COMPILER_BARRIER
+
+#ifndef CONFIG_AUART_ENTER_CRITICAL
+/**
+ * @brief Enter and leave a section the AUART interrupts cannot preempt.
+ *
+ * Only used to emulate compare-and-swap on cores that do not have one,
+ * like the Cortex-M0+. The default masks interrupts through PRIMASK and
+ * restores the previous state on exit.
+ */
+#define CONFIG_AUART_ENTER_CRITICAL()                       \
+    uint32_t __auart_primask;                               \
+    __asm__ volatile("mrs %0, primask\n\tcpsid i"          \
+                     : "=r"(__auart_primask)::"memory")
+#define CONFIG_AUART_EXIT_CRITICAL() \
+    __asm__ volatile("msr primask, %0" ::"r"(__auart_primask) : "memory")
+#endif // !#ifndef CONFIG_AUART_ENTER_CRITICAL
+
 /**
  * ==================================
  *           Error Codes
@@ -54,5 +299,6 @@
 #define AUART_BUSY -4
 #define AUART_NOT_INITIALIZED -5
 #define AUART_NOT_SUPPORTED -6
+#define AUART_OVERRUN -7
 
 #endif // !#ifndef __AUART_CONFIG_H__
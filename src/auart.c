@@ -10,43 +10,387 @@
  */
 
 #include "auart.h"
+#include <stddef.h>
 #include <string.h>
 
 #define AUART_TX_DMA_STOPED 0
+#define AUART_TX_DMA_CLAIMED 1
+#define AUART_TX_DMA_STARTED 2
+
+/**
+ * Accessors of the indices shared between the thread and the IRQ context.
+ *
+ * an `acquire` load pairs with a `release` store of the other side, so
+ * everything written before the store, like the bytes copied into a ring
+ * buffer, is visible after the load.
+ */
+#if (CONFIG_AUART_USE_C11_ATOMICS == 1)
+static inline uint32_t __auart_load(auart_atomic_t *p)
+{
+    return atomic_load_explicit(p, memory_order_relaxed);
+}
+
+static inline uint32_t __auart_load_acquire(auart_atomic_t *p)
+{
+    return atomic_load_explicit(p, memory_order_acquire);
+}
+
+static inline void __auart_store(auart_atomic_t *p, uint32_t value)
+{
+    atomic_store_explicit(p, value, memory_order_relaxed);
+}
+
+static inline void __auart_store_release(auart_atomic_t *p, uint32_t value)
+{
+    atomic_store_explicit(p, value, memory_order_release);
+}
+
+static inline void __auart_fence(void)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+}
+#else
+static inline uint32_t __auart_load(auart_atomic_t *p)
+{
+    return *p;
+}
+
+static inline uint32_t __auart_load_acquire(auart_atomic_t *p)
+{
+    uint32_t value = *p;
+    CONFIG_AUART_COMPILER_BARRIER();
+    return value;
+}
+
+static inline void __auart_store(auart_atomic_t *p, uint32_t value)
+{
+    *p = value;
+}
+
+static inline void __auart_store_release(auart_atomic_t *p, uint32_t value)
+{
+    CONFIG_AUART_COMPILER_BARRIER();
+    *p = value;
+}
+
+static inline void __auart_fence(void)
+{
+    CONFIG_AUART_COMPILER_BARRIER();
+}
+#endif
+
+/**
+ * Whether the indices, and the 32-bit words, can be compared and swapped
+ * without masking the interrupts.
+ */
+#if (CONFIG_AUART_USE_C11_ATOMICS == 1)
+#define AUART_HAVE_CAS32 \
+    ((ATOMIC_INT_LOCK_FREE == 2) && (ATOMIC_LONG_LOCK_FREE == 2))
+#if (AUART_INDEX_WIDTH == 8)
+#define AUART_HAVE_CAS (ATOMIC_CHAR_LOCK_FREE == 2)
+#elif (AUART_INDEX_WIDTH == 16)
+#define AUART_HAVE_CAS (ATOMIC_SHORT_LOCK_FREE == 2)
+#else
+#define AUART_HAVE_CAS AUART_HAVE_CAS32
+#endif
+#else
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#define AUART_HAVE_CAS32 1
+#else
+#define AUART_HAVE_CAS32 0
+#endif
+#if (AUART_INDEX_WIDTH == 8) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_1)
+#define AUART_HAVE_CAS 1
+#elif (AUART_INDEX_WIDTH == 16) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_2)
+#define AUART_HAVE_CAS 1
+#elif (AUART_INDEX_WIDTH == 32)
+#define AUART_HAVE_CAS AUART_HAVE_CAS32
+#else
+#define AUART_HAVE_CAS 0
+#endif
+#endif
+
+/**
+ * Replace `*p` by `desired` if it equals `expected`, as a single atomic
+ * step with respect to all the other contexts.
+ */
+static inline bool __auart_cas(
+    auart_atomic_t *p, uint32_t expected, uint32_t desired)
+{
+    auart_index_t value = expected;
+
+#if (AUART_HAVE_CAS) && (CONFIG_AUART_USE_C11_ATOMICS == 1)
+    return atomic_compare_exchange_strong(p, &value, desired);
+#elif (AUART_HAVE_CAS)
+    return __atomic_compare_exchange_n(
+        p, &value, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+    // no compare-and-swap instruction, e.g. Cortex-M0+
+    bool is_swapped = false;
+
+    CONFIG_AUART_ENTER_CRITICAL();
+    if (*p == value)
+    {
+        *p = desired;
+        is_swapped = true;
+    }
+    CONFIG_AUART_EXIT_CRITICAL();
+
+    return is_swapped;
+#endif
+}
+
+// same as `__auart_load()` and `__auart_cas()`, for the words that keep
+// 32 bits whatever the index width is.
+static inline uint32_t __auart_load32(auart_atomic32_t *p)
+{
+#if (CONFIG_AUART_USE_C11_ATOMICS == 1)
+    return atomic_load_explicit(p, memory_order_relaxed);
+#else
+    return *p;
+#endif
+}
+
+static inline bool __auart_cas32(
+    auart_atomic32_t *p, uint32_t expected, uint32_t desired)
+{
+#if (AUART_HAVE_CAS32) && (CONFIG_AUART_USE_C11_ATOMICS == 1)
+    return atomic_compare_exchange_strong(p, &expected, desired);
+#elif (AUART_HAVE_CAS32)
+    return __atomic_compare_exchange_n(
+        p, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
+    bool is_swapped = false;
+
+    CONFIG_AUART_ENTER_CRITICAL();
+    if (*p == expected)
+    {
+        *p = desired;
+        is_swapped = true;
+    }
+    CONFIG_AUART_EXIT_CRITICAL();
+
+    return is_swapped;
+#endif
+}
+
+static inline void __auart_add32(auart_atomic32_t *p, uint32_t delta)
+{
+#if (AUART_HAVE_CAS32) && (CONFIG_AUART_USE_C11_ATOMICS == 1)
+    atomic_fetch_add(p, delta);
+#elif (AUART_HAVE_CAS32)
+    __atomic_fetch_add(p, delta, __ATOMIC_SEQ_CST);
+#else
+    CONFIG_AUART_ENTER_CRITICAL();
+    *p += delta;
+    CONFIG_AUART_EXIT_CRITICAL();
+#endif
+}
+
+#if (CONFIG_AUART_STATS == 1)
+#define AUART_STATS_WRITER_COUNT_MASK 0xFFFFu
+#define AUART_STATS_WRITER_ENTER 1u
+#define AUART_STATS_WRITER_LEAVE 0xFFFFu // one less inside, one more update
+#define AUART_STATS_MAX_RETRIES 8
+
+#define AUART_STAT(name) (offsetof(auart_stats_t, name) / sizeof(uint32_t))
+
+/**
+ * Update a counter, from any context.
+ *
+ * the counters can be updated by interrupts preempting each other, so the
+ * number of writers inside is counted instead of the usual odd and even
+ * sequence, `auart_get_stats()` only trusts a copy made while it was 0.
+ */
+static inline void __auart_stat_add(
+    auart_t *hauart, uint32_t stat, uint32_t delta)
+{
+    __auart_add32(&hauart->stats_seq, AUART_STATS_WRITER_ENTER);
+    __auart_add32(&hauart->stats[stat], delta);
+    __auart_add32(&hauart->stats_seq, AUART_STATS_WRITER_LEAVE);
+}
+
+static inline void __auart_stat_max(
+    auart_t *hauart, uint32_t stat, uint32_t value)
+{
+    uint32_t max = __auart_load32(&hauart->stats[stat]);
+    if (value <= max)
+        return;
+
+    __auart_add32(&hauart->stats_seq, AUART_STATS_WRITER_ENTER);
+    while (value > max &&
+           !__auart_cas32(&hauart->stats[stat], max, value))
+        max = __auart_load32(&hauart->stats[stat]);
+    __auart_add32(&hauart->stats_seq, AUART_STATS_WRITER_LEAVE);
+}
+#else
+#define AUART_STAT(name) 0
+
+static inline void __auart_stat_add(
+    auart_t *hauart, uint32_t stat, uint32_t delta)
+{
+    (void)hauart;
+    (void)stat;
+    (void)delta;
+}
+
+static inline void __auart_stat_max(
+    auart_t *hauart, uint32_t stat, uint32_t value)
+{
+    (void)hauart;
+    (void)stat;
+    (void)value;
+}
+#endif
 
 int auart_init(auart_t *hauart, auart_init_t *init)
 {
     // argument sanity checks
-    if (hauart == NULL || init == NULL)
+    if (hauart == NULL || init == NULL || init->ops == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    const auart_ops_t *ops = init->ops;
+
+    if (init->dir != AUART_DIR_BOTH &&
+        init->dir != AUART_DIR_TX_ONLY &&
+        init->dir != AUART_DIR_RX_ONLY)
+        return AUART_INVALID_ARGUMENT;
+
+    bool has_tx = init->dir != AUART_DIR_RX_ONLY;
+    bool has_rx = init->dir != AUART_DIR_TX_ONLY;
+
+    // the callbacks of an unused direction are never called
+    if (has_rx && (ops->dma_rx_start == NULL ||
+                   ops->dma_rx_abort == NULL ||
+                   ops->dma_rx_update_progress == NULL))
         return AUART_INVALID_ARGUMENT;
 
-    if (init->dma_rx_start == NULL ||
-        init->dma_rx_abort == NULL ||
-        init->dma_rx_update_progress == NULL)
+    if (has_tx && (ops->dma_tx_abort == NULL ||
+                   ops->dma_tx_start == NULL))
         return AUART_INVALID_ARGUMENT;
 
-    if (init->dma_tx_abort == NULL ||
-        init->dma_tx_start == NULL)
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_FLOW_CONTROL)
+    if (has_rx && ops->rx_flow == NULL)
         return AUART_INVALID_ARGUMENT;
+#endif
 
 #if (CONFIG_AUART_USE_TIME_API == 1)
-    if (init->get_tick_ms == NULL)
+    if (ops->get_tick_ms == NULL)
+        return AUART_INVALID_ARGUMENT;
+#endif
+
+#if (CONFIG_AUART_TX_DEFERRED_KICK == 1)
+    if (has_tx && ops->pend_deferred == NULL)
+        return AUART_INVALID_ARGUMENT;
+#endif
+
+    uint8_t *tx_buffer = NULL;
+    int32_t tx_size = 0;
+    uint8_t *rx_buffer = NULL;
+    int32_t rx_size = 0;
+
+    if (has_tx)
+    {
+        tx_buffer = init->tx_buffer;
+        tx_size = init->tx_buffer_size;
+
+        // fall back to the built-in buffer
+#if (CONFIG_AUART_TX_BUFFER_SIZE > 0)
+        if (tx_buffer == NULL)
+        {
+            tx_buffer = hauart->tx_storage;
+            tx_size = CONFIG_AUART_TX_BUFFER_SIZE;
+        }
+#endif
+
+        if (tx_buffer == NULL || tx_size < 1)
+            return AUART_INVALID_ARGUMENT;
+
+        if (CONFIG_AUART_TX_COALESCE_MIN_SIZE >= tx_size)
+            return AUART_INVALID_ARGUMENT;
+
+        if (init->tx_policy != AUART_TX_PARTIAL &&
+            init->tx_policy != AUART_TX_ALL_OR_NOTHING &&
+            init->tx_policy != AUART_TX_OVERWRITE_OLDEST &&
+            init->tx_policy != AUART_TX_BLOCK)
+            return AUART_INVALID_ARGUMENT;
+
+#if (CONFIG_AUART_USE_TIME_API != 1)
+        // without a clock a finite wait never expires, only waiting not at
+        // all or forever can be kept.
+        if (init->tx_policy == AUART_TX_BLOCK &&
+            init->tx_timeout_ms != 0 &&
+            init->tx_timeout_ms != AUART_WAIT_FOREVER)
+            return AUART_INVALID_ARGUMENT;
+#endif
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+        // the pending data can only be moved by its single producer
+        if (init->tx_policy == AUART_TX_OVERWRITE_OLDEST)
+            return AUART_INVALID_ARGUMENT;
+#endif
+    }
+
+    if (has_rx)
+    {
+        rx_buffer = init->rx_buffer;
+        rx_size = init->rx_buffer_size;
+
+#if (CONFIG_AUART_RX_BUFFER_SIZE > 0)
+        if (rx_buffer == NULL)
+        {
+            rx_buffer = hauart->rx_storage;
+            rx_size = CONFIG_AUART_RX_BUFFER_SIZE;
+        }
+#endif
+
+        // the RX buffer is reported in two halves
+        if (rx_buffer == NULL || rx_size < 2)
+            return AUART_INVALID_ARGUMENT;
+    }
+
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0)
+    // would not fit in `auart_index_t`
+    if (tx_size > CONFIG_AUART_MAX_BUFFER_SIZE ||
+        rx_size > CONFIG_AUART_MAX_BUFFER_SIZE)
         return AUART_INVALID_ARGUMENT;
 #endif
 
     // clear the device
     memset(hauart, 0, sizeof(auart_t));
 
-    // copy datas
-    hauart->op = *init;
+    // the table is shared, only the handles are per port
+    hauart->op = ops;
+    hauart->dir = init->dir;
+    hauart->tx_policy = init->tx_policy;
+    hauart->tx_timeout_ms = init->tx_timeout_ms;
+    hauart->h_rxdma = init->h_rxdma;
+    hauart->h_txdma = init->h_txdma;
+    hauart->h_event = init->h_event;
+    hauart->h_deferred = init->h_deferred;
+
+    hauart->tx_buffer = tx_buffer;
+    hauart->tx_size = tx_size;
+    hauart->rx_buffer = rx_buffer;
+    hauart->rx_size = rx_size;
+
+    // the rx dma channel is not even touched on a tx only port
+    if (!has_rx)
+        return AUART_OK;
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_FLOW_CONTROL)
+    int res = hauart->op->rx_flow(hauart->h_rxdma, false);
+    if (res < 0)
+        return res;
+#else
+    int res;
+#endif
 
-    // start the rx dma
-    int res = hauart->op.dma_rx_start(
-        hauart,
+    // start the rx dma, it runs in circular mode over the whole rx buffer
+    res = hauart->op->dma_rx_start(
+        hauart->h_rxdma,
         hauart->rx_buffer,
-        CONFIG_AUART_RX_BUFFER_SIZE - 1);
-    hauart->rx_start = 0;
-    hauart->rx_batch_size = CONFIG_AUART_RX_BUFFER_SIZE - 1;
+        hauart->rx_size);
 
     if (res < 0)
         return res;
@@ -54,40 +398,141 @@ int auart_init(auart_t *hauart, auart_init_t *init)
     return AUART_OK;
 }
 
-static inline int32_t __auart_get_capacity_in_tx_buffer(auart_t *hauart)
+static inline bool __auart_has_tx(auart_t *hauart)
+{
+    return hauart->dir != AUART_DIR_RX_ONLY;
+}
+
+static inline bool __auart_has_rx(auart_t *hauart)
 {
-    int32_t size_in_buffer = CONFIG_AUART_TX_BUFFER_SIZE;
-    size_in_buffer -= hauart->tx_head;
-    size_in_buffer += hauart->tx_tail;
-    size_in_buffer %= CONFIG_AUART_TX_BUFFER_SIZE;
+    return hauart->dir != AUART_DIR_TX_ONLY;
+}
 
-    return size_in_buffer;
+/**
+ * The ring indices run over [0, 2 * size), a position in the buffer is the
+ * index modulo the size. Equal indices mean an empty buffer and indices
+ * `size` apart a full one, so no byte is wasted, and as an index never
+ * moves by more than the size at once, a compare and a subtraction do
+ * the modulo without a division.
+ */
+static inline uint32_t __auart_wrap(int32_t size, uint32_t index)
+{
+    if (index >= (uint32_t)size * 2)
+        index -= size * 2;
+
+    return index;
 }
 
-static inline int32_t __auart_get_capacity_in_rx_buffer(auart_t *hauart)
+static inline int32_t __auart_pos(int32_t size, uint32_t index)
 {
-    int32_t size_in_buffer = CONFIG_AUART_RX_BUFFER_SIZE;
-    size_in_buffer += hauart->rx_head;
-    size_in_buffer -= hauart->rx_tail;
-    size_in_buffer %= CONFIG_AUART_RX_BUFFER_SIZE;
+    if (index >= (uint32_t)size)
+        index -= size;
 
-    return size_in_buffer;
+    return index;
+}
+
+static inline int32_t __auart_dist(int32_t size, uint32_t from, uint32_t to)
+{
+    int32_t dist = to - from;
+    if (dist < 0)
+        dist += size * 2;
+
+    return dist;
+}
+
+static inline uint32_t __auart_tx_wrap(auart_t *hauart, uint32_t index)
+{
+    return __auart_wrap(hauart->tx_size, index);
+}
+
+static inline uint32_t __auart_rx_wrap(auart_t *hauart, uint32_t index)
+{
+    return __auart_wrap(hauart->rx_size, index);
+}
+
+static inline int32_t __auart_get_tx_head(auart_t *hauart)
+{
+    int32_t tx_head = __auart_load_acquire(&hauart->tx_head);
+
+    if (hauart->op->dma_tx_update_progress == NULL)
+        return tx_head;
+
+    while (1)
+    {
+        // the size is not trusted until the dma is actually started
+        if (__auart_load_acquire(&hauart->tx_dma_state) != AUART_TX_DMA_STARTED)
+            return tx_head;
+
+        int32_t commited_size = __auart_load(&hauart->tx_dma_size);
+
+        uint32_t tx_dma_transfers_left = 0;
+        int res = hauart->op->dma_tx_update_progress(
+            hauart->h_txdma,
+            &tx_dma_transfers_left);
+
+        if (res < 0)
+            return tx_head;
+
+        // the transfer completed while we were reading the progress,
+        // the head has moved and `commited_size` belongs to a new transfer.
+        int32_t new_tx_head = __auart_load_acquire(&hauart->tx_head);
+        if (new_tx_head != tx_head)
+        {
+            tx_head = new_tx_head;
+            continue;
+        }
+
+        if (tx_dma_transfers_left > (uint32_t)commited_size)
+            return tx_head;
+
+        int32_t tx_sent = commited_size - tx_dma_transfers_left;
+        tx_head += tx_sent;
+        tx_head = __auart_tx_wrap(hauart, tx_head);
+
+        return tx_head;
+    }
 }
 
 static inline int32_t __auart_get_data_size_in_tx_buffer(auart_t *hauart)
 {
-    int32_t size_in_buffer = __auart_get_capacity_in_tx_buffer(hauart);
-    int32_t data_len = CONFIG_AUART_TX_BUFFER_SIZE - 1 - size_in_buffer;
+    int32_t tx_head = __auart_get_tx_head(hauart);
+    int32_t tx_tail = __auart_load_acquire(&hauart->tx_tail);
 
-    return data_len;
+    return __auart_dist(hauart->tx_size, tx_head, tx_tail);
 }
 
 static inline int32_t __auart_get_data_size_in_rx_buffer(auart_t *hauart)
 {
-    int32_t size_in_buffer = __auart_get_capacity_in_rx_buffer(hauart);
-    int32_t data_len = CONFIG_AUART_RX_BUFFER_SIZE - size_in_buffer;
+    int32_t rx_head = __auart_load(&hauart->rx_head);
+    int32_t rx_tail = __auart_load_acquire(&hauart->rx_tail);
+
+    return __auart_dist(hauart->rx_size, rx_head, rx_tail);
+}
+
+static inline int32_t __auart_get_capacity_in_tx_buffer(auart_t *hauart)
+{
+    int32_t data_len = __auart_get_data_size_in_tx_buffer(hauart);
+    int32_t capacity = hauart->tx_size - data_len;
+
+    return capacity;
+}
+
+static inline uint32_t __auart_get_tick_ms(auart_t *hauart)
+{
+#if (CONFIG_AUART_USE_TIME_API == 1)
+    return hauart->op->get_tick_ms();
+#else
+    (void)hauart;
+    return 0;
+#endif
+}
+
+static inline void __auart_notify_event(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
 
-    return data_len;
+    if (hauart->op->notify_event != NULL)
+        hauart->op->notify_event(hauart->h_event);
 }
 
 static inline int __auart_tx_dma_continue(auart_t *hauart)
@@ -95,177 +540,1754 @@ static inline int __auart_tx_dma_continue(auart_t *hauart)
     //? this function is in IRQ context ?//
     //? this function is in thread context ?//
 
-    int32_t tx_tail = hauart->tx_tail;
-    int32_t tx_head = hauart->tx_head;
+    int32_t tx_tail;
+    int32_t tx_head;
 
-    // check if the dma is already started
-    if (hauart->tx_dma.is_started)
-        return AUART_OK;
+    do
+    {
+        // claim the dma, only the winner may start it. if someone else
+        // owns it, the data will be picked up by the next complete irq.
+        if (!__auart_cas(&hauart->tx_dma_state,
+                         AUART_TX_DMA_STOPED, AUART_TX_DMA_CLAIMED))
+            return AUART_OK;
+
+        // the writer kicks the dma once it is done moving the data
+        if (hauart->tx_rewriting)
+        {
+            __auart_store_release(&hauart->tx_dma_state, AUART_TX_DMA_STOPED);
+            return AUART_OK;
+        }
+
+        tx_tail = __auart_load_acquire(&hauart->tx_tail);
+        tx_head = __auart_load(&hauart->tx_head);
+
+        // check if there is anything to send
+        if (tx_head != tx_tail)
+            break;
+
+        // nope, give the dma back. a writer that committed after our
+        // read may have seen it claimed and skipped the start, so look
+        // again once the release is visible.
+        __auart_store_release(&hauart->tx_dma_state, AUART_TX_DMA_STOPED);
+        __auart_fence();
+    } while ((int32_t)__auart_load_acquire(&hauart->tx_tail) != tx_tail);
 
-    // check if there is anything to send
     if (tx_head == tx_tail)
-        return AUART_OK; // nope
+        return AUART_OK;
 
-    int32_t num_byte_to_send = 0;
+    // up to the tail or the end of the buffer, whichever comes first
+    int32_t tx_head_pos = __auart_pos(hauart->tx_size, tx_head);
+    int32_t num_byte_to_send = __auart_dist(hauart->tx_size, tx_head, tx_tail);
+    if (num_byte_to_send > hauart->tx_size - tx_head_pos)
+        num_byte_to_send = hauart->tx_size - tx_head_pos;
 
-    if (tx_head < tx_tail)
-        num_byte_to_send = tx_tail - tx_head;
-    else
-        num_byte_to_send = CONFIG_AUART_TX_BUFFER_SIZE - tx_head;
+    uint8_t *pdata = hauart->tx_buffer + tx_head_pos;
+
+    // must be set before the start, the complete irq may fire right away.
+    __auart_store_release(&hauart->tx_dma_size, num_byte_to_send);
+
+    // the data wraps around the buffer, queue the part at its beginning
+    // behind the transfer. the dma is claimed and not running yet, no
+    // complete irq can see the queue half set up.
+    int32_t num_byte_to_queue = 0;
+    if (hauart->op->dma_tx_queue != NULL)
+    {
+        num_byte_to_queue =
+            __auart_dist(hauart->tx_size, tx_head, tx_tail) - num_byte_to_send;
+
+        if (num_byte_to_queue > 0)
+        {
+            hauart->tx_dma_queued_size = num_byte_to_queue;
+
+            if (hauart->op->dma_tx_queue(
+                    hauart->h_txdma,
+                    hauart->tx_buffer,
+                    num_byte_to_queue) < 0)
+            {
+                // sent by the next start instead
+                hauart->tx_dma_queued_size = 0;
+                num_byte_to_queue = 0;
+            }
+        }
+    }
 
-    uint8_t *pdata = hauart->tx_buffer + tx_head;
+#if (CONFIG_AUART_TX_COALESCE_HOLD_MS > 0)
+    hauart->tx_holding = false;
+#endif
 
     // start the dma
-    int res = hauart->op.dma_tx_start(
-        hauart->op.h_txdma,
+    int res = hauart->op->dma_tx_start(
+        hauart->h_txdma,
         pdata,
         num_byte_to_send);
 
     if (res < 0)
+    {
+        // the port drops the queued transfer as well
+        if (num_byte_to_queue > 0)
+        {
+            hauart->op->dma_tx_abort(hauart->h_txdma);
+            hauart->tx_dma_queued_size = 0;
+        }
+
+        // the data stays in the buffer for the next kick
+        __auart_store_release(&hauart->tx_dma_state, AUART_TX_DMA_STOPED);
         return res;
+    }
+
+    // from now on the dma is owned by `auart_tx_cplt_callback()`. if it
+    // already ran and released the dma, the swap fails and that is fine.
+    __auart_cas(&hauart->tx_dma_state,
+                AUART_TX_DMA_CLAIMED, AUART_TX_DMA_STARTED);
+
+    __auart_stat_add(hauart, AUART_STAT(tx_dma_starts),
+                     num_byte_to_queue > 0 ? 2 : 1);
 
-    // this will also mark the tx dma as started.
-    hauart->tx_dma.commited_size = num_byte_to_send;
     return 0;
 }
 
-int auart_tx_cplt_callback(auart_t *hauart)
+static inline int __auart_tx_dma_kick(auart_t *hauart)
 {
     //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
 
-    // update the head
-    int32_t new_head = hauart->tx_head;
-    new_head += hauart->tx_dma.commited_size;
-    new_head %= CONFIG_AUART_TX_BUFFER_SIZE;
+#if (CONFIG_AUART_TX_DEFERRED_KICK == 1)
+    // `auart_deferred_handler()` does the rest
+    hauart->op->pend_deferred(hauart->h_deferred);
+    return AUART_OK;
+#else
+    return __auart_tx_dma_continue(hauart);
+#endif
+}
 
-    hauart->tx_head = new_head;
+static inline bool __auart_tx_should_hold(auart_t *hauart)
+{
+    //? this function is in thread context ?//
 
-    // stop the dma
-    hauart->tx_dma.is_started = AUART_TX_DMA_STOPED;
+#if (CONFIG_AUART_TX_COALESCE_MIN_SIZE > 0)
+    int32_t size_pending = __auart_get_data_size_in_tx_buffer(hauart);
+    if (size_pending >= CONFIG_AUART_TX_COALESCE_MIN_SIZE)
+        return false;
+
+#if (CONFIG_AUART_TX_COALESCE_HOLD_MS > 0)
+    uint32_t now = hauart->op->get_tick_ms();
+    if (!hauart->tx_holding)
+    {
+        hauart->tx_hold_tick = now;
+        hauart->tx_holding = true;
+        return true;
+    }
 
-    int32_t need_transfer = __auart_get_data_size_in_tx_buffer(hauart);
-    if (need_transfer)
-        return __auart_tx_dma_continue(hauart);
+    if (now - hauart->tx_hold_tick >= CONFIG_AUART_TX_COALESCE_HOLD_MS)
+        return false;
+#endif
 
-    return 0;
+    return true;
+#else
+    (void)hauart;
+    return false;
+#endif
 }
 
-int auart_tx(auart_t *hauart, const void *data, int32_t len)
+static inline int __auart_tx_dma_queue_next(auart_t *hauart)
 {
-    //? this function is in thread context ?//
-
-    uint8_t *pu8data = (uint8_t *)data;
-    int32_t size_in_buffer = __auart_get_capacity_in_tx_buffer(hauart);
+    //? this function is in IRQ context ?//
 
-    int32_t size_available = CONFIG_AUART_TX_BUFFER_SIZE - 1;
-    size_available -= size_in_buffer;
+    if (hauart->op->dma_tx_queue == NULL)
+        return AUART_OK;
 
-    int32_t size_to_copy = len;
-    if (size_to_copy > size_available)
-        size_to_copy = size_available;
+    // only one transfer can be queued behind the running one
+    if (__auart_load(&hauart->tx_dma_state) == AUART_TX_DMA_STOPED ||
+        hauart->tx_dma_queued_size || hauart->tx_rewriting)
+        return AUART_OK;
 
-    if (size_available <= 0)
-        return 0;
+    int32_t commited_size = __auart_load(&hauart->tx_dma_size);
 
-    int32_t new_tail = (hauart->tx_tail + size_to_copy);
-    new_tail %= CONFIG_AUART_TX_BUFFER_SIZE;
+    int32_t tx_tail = __auart_load_acquire(&hauart->tx_tail);
+    int32_t tx_next = __auart_load(&hauart->tx_head) + commited_size;
+    tx_next = __auart_tx_wrap(hauart, tx_next);
 
-    int32_t size_to_end = CONFIG_AUART_TX_BUFFER_SIZE;
-    size_to_end = size_to_end - hauart->tx_tail;
+    // check if there is anything to queue
+    if (tx_next == tx_tail)
+        return AUART_OK;
 
-    int32_t size_first_copy = size_to_copy;
-    if (size_first_copy > size_to_end)
-        size_first_copy = size_to_end;
+    int32_t tx_next_pos = __auart_pos(hauart->tx_size, tx_next);
+    int32_t num_byte_to_queue = __auart_dist(hauart->tx_size, tx_next, tx_tail);
+    if (num_byte_to_queue > hauart->tx_size - tx_next_pos)
+        num_byte_to_queue = hauart->tx_size - tx_next_pos;
 
-    memcpy(hauart->tx_buffer + hauart->tx_tail, data, size_first_copy);
+    uint8_t *pdata = hauart->tx_buffer + tx_next_pos;
 
-    int32_t size_second_copy = size_to_copy - size_first_copy;
-    if (size_second_copy == 0)
-        goto copy_done;
+    hauart->tx_dma_queued_size = num_byte_to_queue;
 
-    memcpy(hauart->tx_buffer, pu8data + size_first_copy, size_second_copy);
+    int res = hauart->op->dma_tx_queue(
+        hauart->h_txdma,
+        pdata,
+        num_byte_to_queue);
 
-copy_done:
-    hauart->tx_tail = new_tail;
+    if (res < 0)
+    {
+        // the data will be sent by the next `__auart_tx_dma_continue()`
+        hauart->tx_dma_queued_size = 0;
+        return res;
+    }
 
-    if (!hauart->tx_dma.is_started)
-        __auart_tx_dma_continue(hauart);
+    __auart_stat_add(hauart, AUART_STAT(tx_dma_starts), 1);
 
-    return size_to_copy;
+    return AUART_OK;
 }
 
-int auart_rx(auart_t *hauart, void *data, int32_t len)
+int auart_tx_cplt_callback(auart_t *hauart)
 {
-    //? this function is in thread context ?//
-
-    int32_t rx_head = hauart->rx_head;
-    int32_t rx_tail = hauart->rx_tail;
-
-    if (rx_head == rx_tail)
-        return 0;
+    //? this function is in IRQ context ?//
 
-    int32_t size_in_buffer = CONFIG_AUART_RX_BUFFER_SIZE;
-    size_in_buffer += rx_tail;
-    size_in_buffer -= rx_head;
-    size_in_buffer %= CONFIG_AUART_RX_BUFFER_SIZE;
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
 
-    int32_t size_to_copy = len;
-    if (size_to_copy > size_in_buffer)
-        size_to_copy = size_in_buffer;
+    // update the head
+    int32_t tx_dma_size = __auart_load(&hauart->tx_dma_size);
+    int32_t new_head = __auart_load(&hauart->tx_head) + tx_dma_size;
+    new_head = __auart_tx_wrap(hauart, new_head);
 
-    int32_t size_to_end = CONFIG_AUART_RX_BUFFER_SIZE;
-    size_to_end -= rx_tail;
+    __auart_store_release(&hauart->tx_head, new_head);
 
-    int32_t size_first_copy = size_to_copy;
-    if (size_first_copy > size_to_end)
-        size_first_copy = size_to_end;
+    __auart_stat_add(hauart, AUART_STAT(tx_bytes), tx_dma_size);
 
-    memcpy(data, hauart->rx_buffer + rx_head, size_first_copy);
+    __auart_notify_event(hauart);
 
-    int32_t size_second_copy = size_to_copy - size_first_copy;
-    int32_t new_head = rx_head;
-    new_head += size_to_copy;
-    new_head %= CONFIG_AUART_RX_BUFFER_SIZE;
-    if (size_second_copy == 0)
+    // the queued transfer is already running, keep the dma started and
+    // queue the data committed since then behind it.
+    int32_t queued_size = hauart->tx_dma_queued_size;
+    if (queued_size)
     {
-        hauart->rx_head = new_head;
-        return size_to_copy;
+        __auart_store_release(&hauart->tx_dma_size, queued_size);
+        hauart->tx_dma_queued_size = 0;
+        return __auart_tx_dma_queue_next(hauart);
     }
 
-    memcpy((uint8_t *)data + size_first_copy, hauart->rx_buffer, size_second_copy);
-
-    hauart->rx_head = new_head;
-    return size_to_copy;
-}
-
-int auart_idle_callback(auart_t *hauart)
-{
-    uint32_t rx_dma_transfers_left = 0;
+    // hand the dma back, then claim it again if anything is left. a
+    // writer may win the claim in between, which is fine.
+    __auart_store_release(&hauart->tx_dma_state, AUART_TX_DMA_STOPED);
 
-    int res = hauart->op.dma_rx_update_progress(
-        hauart->op.h_rxdma,
-        &rx_dma_transfers_left);
+#if (CONFIG_AUART_TX_DEFERRED_KICK == 1)
+    // the data committed since then waits for the deferred handler, the
+    // transfer started there is queued behind by the next complete irq.
+    if (__auart_get_data_size_in_tx_buffer(hauart) == 0)
+        return AUART_OK;
+#endif
 
+    int res = __auart_tx_dma_kick(hauart);
     if (res < 0)
         return res;
 
-    int32_t rx_bs = hauart->rx_batch_size;
-    int32_t rx_start = hauart->rx_start;
-    int32_t rx_cnt = rx_bs - rx_dma_transfers_left;
-    int32_t new_rx_tail = rx_start + rx_cnt;
-    new_rx_tail %= CONFIG_AUART_RX_BUFFER_SIZE;
-
-    hauart->rx_tail = new_rx_tail;
-    
-    return 0;
+    return __auart_tx_dma_queue_next(hauart);
 }
 
-int auart_dma_rx_half_cplt_callback(auart_t *hauart)
+int auart_deferred_handler(auart_t *hauart)
 {
-    return 0;
+    //? this function is in IRQ context ?//
+
+    if (hauart == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+#if (CONFIG_AUART_TX_DEFERRED_KICK == 1)
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    return __auart_tx_dma_continue(hauart);
+#else
+    return AUART_NOT_SUPPORTED;
+#endif
 }
 
-int auart_dma_rx_cplt_callback(auart_t *hauart)
+int auart_tx_reserve(auart_t *hauart, auart_span_t spans[2])
 {
-    return 0;
-}
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || spans == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    // the spans would have to stay claimed until the commit
+    return AUART_NOT_SUPPORTED;
+#endif
+
+    int32_t tx_tail = __auart_load(&hauart->tx_tail);
+    int32_t size_available = __auart_get_capacity_in_tx_buffer(hauart);
+
+    int32_t tx_tail_pos = __auart_pos(hauart->tx_size, tx_tail);
+    int32_t size_to_end = hauart->tx_size - tx_tail_pos;
+
+    spans[0].data = hauart->tx_buffer + tx_tail_pos;
+    spans[1].data = hauart->tx_buffer;
+
+    if (size_available <= size_to_end)
+    {
+        spans[0].len = size_available;
+        spans[1].len = 0;
+    }
+    else
+    {
+        spans[0].len = size_to_end;
+        spans[1].len = size_available - size_to_end;
+    }
+
+    return size_available;
+}
+
+int auart_tx_commit(auart_t *hauart, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    return AUART_NOT_SUPPORTED;
+#endif
+
+    int32_t size_available = __auart_get_capacity_in_tx_buffer(hauart);
+
+    int32_t size_to_commit = len;
+    if (size_to_commit > size_available)
+        size_to_commit = size_available;
+
+    if (size_to_commit == 0)
+        return 0;
+
+    int32_t new_tail = __auart_load(&hauart->tx_tail) + size_to_commit;
+    new_tail = __auart_tx_wrap(hauart, new_tail);
+
+    __auart_store_release(&hauart->tx_tail, new_tail);
+
+#if (CONFIG_AUART_STATS == 1)
+    __auart_stat_max(hauart, AUART_STAT(tx_high_water),
+                     __auart_dist(hauart->tx_size,
+                                  __auart_load(&hauart->tx_head), new_tail));
+#endif
+
+    // pairs with the fence in `__auart_tx_dma_continue()`, either we see
+    // the dma released or the releasing side sees our tail.
+    __auart_fence();
+
+    if (__auart_load(&hauart->tx_dma_state) == AUART_TX_DMA_STOPED &&
+        !__auart_tx_should_hold(hauart))
+        __auart_tx_dma_kick(hauart);
+
+    return size_to_commit;
+}
+
+int auart_tx_kick(auart_t *hauart)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    return __auart_tx_dma_kick(hauart);
+}
+
+static inline void __auart_write_spans(
+    auart_span_t spans[2], int32_t offset, const uint8_t *src, int32_t len)
+{
+    // copy `len` bytes to the spans, starting `offset` bytes into them
+    if (offset < spans[0].len)
+    {
+        int32_t size_first_copy = spans[0].len - offset;
+        if (size_first_copy > len)
+            size_first_copy = len;
+
+        memcpy(spans[0].data + offset, src, size_first_copy);
+
+        src += size_first_copy;
+        len -= size_first_copy;
+        offset = spans[0].len;
+    }
+
+    if (len == 0)
+        return;
+
+    memcpy(spans[1].data + (offset - spans[0].len), src, len);
+}
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+#define AUART_TX_WRITER_COUNT_MASK 0xFFu
+#define AUART_TX_WRITER_ENTER 0x101u // one more inside, one more entered
+
+static inline void __auart_tx_enter(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+    uint32_t writers;
+
+    do
+        writers = __auart_load32(&hauart->tx_writers);
+    while (!__auart_cas32(&hauart->tx_writers,
+                        writers, writers + AUART_TX_WRITER_ENTER));
+}
+
+static inline int32_t __auart_tx_claim(
+    auart_t *hauart, int32_t len, bool is_partial, auart_span_t spans[2])
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+    int32_t tx_claim;
+    int32_t size_to_claim;
+
+    do
+    {
+        tx_claim = __auart_load(&hauart->tx_claim);
+
+        // same as `__auart_get_capacity_in_tx_buffer()`, but counting the
+        // ranges claimed by the other writers as used.
+        int32_t data_len = __auart_dist(
+            hauart->tx_size, __auart_get_tx_head(hauart), tx_claim);
+
+        int32_t size_available = hauart->tx_size - data_len;
+
+        size_to_claim = len;
+        if (size_to_claim > size_available)
+        {
+            if (!is_partial)
+                return 0;
+
+            size_to_claim = size_available;
+        }
+
+        if (size_to_claim == 0)
+            return 0;
+
+    } while (!__auart_cas(&hauart->tx_claim, tx_claim,
+                          __auart_tx_wrap(hauart, tx_claim + size_to_claim)));
+
+#if (CONFIG_AUART_STATS == 1)
+    __auart_stat_max(hauart, AUART_STAT(tx_high_water),
+                     __auart_dist(hauart->tx_size,
+                                  __auart_load(&hauart->tx_head),
+                                  __auart_tx_wrap(hauart,
+                                                  tx_claim + size_to_claim)));
+#endif
+
+    int32_t tx_claim_pos = __auart_pos(hauart->tx_size, tx_claim);
+    int32_t size_to_end = hauart->tx_size - tx_claim_pos;
+
+    spans[0].data = hauart->tx_buffer + tx_claim_pos;
+    spans[1].data = hauart->tx_buffer;
+
+    if (size_to_claim <= size_to_end)
+    {
+        spans[0].len = size_to_claim;
+        spans[1].len = 0;
+    }
+    else
+    {
+        spans[0].len = size_to_end;
+        spans[1].len = size_to_claim - size_to_end;
+    }
+
+    return size_to_claim;
+}
+
+static inline void __auart_tx_publish(auart_t *hauart, uint32_t new_tail)
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+    while (1)
+    {
+        uint32_t tx_tail = __auart_load(&hauart->tx_tail);
+        uint32_t tx_claim = __auart_load(&hauart->tx_claim);
+
+        int32_t size_claimed = __auart_dist(
+            hauart->tx_size, tx_tail, tx_claim);
+        int32_t size_to_publish = __auart_dist(
+            hauart->tx_size, tx_tail, new_tail);
+
+        // a writer that came later may have already published further
+        // than us while we were preempted, the tail never moves back.
+        if (size_to_publish == 0 || size_to_publish > size_claimed)
+            return;
+
+        if (__auart_cas(&hauart->tx_tail, tx_tail, new_tail))
+            return;
+    }
+}
+
+static inline bool __auart_tx_leave(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+    while (1)
+    {
+        uint32_t writers = __auart_load32(&hauart->tx_writers);
+
+        // another writer is still filling its range, the last one out
+        // publishes ours together with its own.
+        if ((writers & AUART_TX_WRITER_COUNT_MASK) > 1)
+        {
+            if (__auart_cas32(&hauart->tx_writers, writers, writers - 1))
+                return false;
+
+            continue;
+        }
+
+        // we are the last one, every range claimed so far is filled. a
+        // writer entering from now on changes the entered count in the
+        // upper bits, so the swap below fails even if it already left.
+        uint32_t tx_claim = __auart_load(&hauart->tx_claim);
+
+        if (__auart_cas32(&hauart->tx_writers, writers, writers - 1))
+        {
+            __auart_tx_publish(hauart, tx_claim);
+            return true;
+        }
+    }
+}
+
+static int __auart_tx_write(
+    auart_t *hauart,
+    const auart_iovec_t *iov,
+    int32_t iovcnt,
+    int32_t total_len,
+    bool is_partial)
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+    auart_span_t spans[2];
+
+    __auart_tx_enter(hauart);
+
+    int32_t size_claimed = __auart_tx_claim(
+        hauart, total_len, is_partial, spans);
+
+    if (size_claimed < total_len)
+        __auart_stat_add(hauart, AUART_STAT(tx_full_rejects), 1);
+
+    int32_t offset = 0;
+    for (int32_t i = 0; i < iovcnt && offset < size_claimed; i++)
+    {
+        int32_t size_to_copy = iov[i].len;
+        if (size_to_copy > size_claimed - offset)
+            size_to_copy = size_claimed - offset;
+
+        __auart_write_spans(spans, offset, iov[i].data, size_to_copy);
+        offset += size_to_copy;
+    }
+
+    // even with nothing claimed, we may be the last writer out and have
+    // to publish the data of the writers that preempted us.
+    if (!__auart_tx_leave(hauart))
+        return size_claimed;
+
+    // pairs with the fence in `__auart_tx_dma_continue()`.
+    __auart_fence();
+
+    if (__auart_load(&hauart->tx_dma_state) == AUART_TX_DMA_STOPED)
+        __auart_tx_dma_kick(hauart);
+
+    return size_claimed;
+}
+#endif
+
+static inline int __auart_wait_event(
+    auart_t *hauart, uint32_t start_tick, uint32_t timeout_ms)
+{
+    //? this function is in thread context ?//
+
+    uint32_t wait_ms = AUART_WAIT_FOREVER;
+
+    if (timeout_ms != AUART_WAIT_FOREVER)
+    {
+        uint32_t elapsed = __auart_get_tick_ms(hauart) - start_tick;
+        if (elapsed >= timeout_ms)
+            return AUART_TIMEOUT;
+
+        wait_ms = timeout_ms - elapsed;
+    }
+
+    // no wait hook, busy polling
+    if (hauart->op->wait_event == NULL)
+        return AUART_OK;
+
+    return hauart->op->wait_event(hauart->h_event, wait_ms);
+}
+
+static int __auart_tx_partial(auart_t *hauart, const void *data, int32_t len)
+{
+    //? this function is in IRQ context ?//
+    //? this function is in thread context ?//
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    auart_iovec_t iov = {data, len};
+    return __auart_tx_write(hauart, &iov, 1, len, true);
+#else
+    auart_span_t spans[2];
+    int res = auart_tx_reserve(hauart, spans);
+    if (res < 0)
+        return res;
+
+    int32_t size_to_copy = len;
+    if (size_to_copy > res)
+    {
+        size_to_copy = res;
+        __auart_stat_add(hauart, AUART_STAT(tx_full_rejects), 1);
+    }
+
+    if (size_to_copy == 0)
+        return 0;
+
+    __auart_write_spans(spans, 0, (const uint8_t *)data, size_to_copy);
+
+    return auart_tx_commit(hauart, size_to_copy);
+#endif
+}
+
+static int __auart_tx_block(auart_t *hauart, const void *data, int32_t len,
+                            uint32_t timeout_ms)
+{
+    //? this function is in thread context ?//
+
+    const uint8_t *pu8data = (const uint8_t *)data;
+    uint32_t start_tick = __auart_get_tick_ms(hauart);
+    int32_t size_sent = 0;
+
+    while (1)
+    {
+        int res = __auart_tx_partial(
+            hauart, pu8data + size_sent, len - size_sent);
+        if (res < 0)
+            return res;
+
+        size_sent += res;
+        if (size_sent == len)
+            return size_sent;
+
+        res = __auart_wait_event(hauart, start_tick, timeout_ms);
+        if (res == AUART_TIMEOUT)
+            return size_sent;
+
+        if (res < 0)
+            return res;
+    }
+}
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 0)
+static inline void __auart_tx_move(
+    auart_t *hauart, uint32_t dst, uint32_t src, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    // `dst` is behind `src`, a forward copy never overwrites what is left
+    // to be moved.
+    while (len > 0)
+    {
+        int32_t dst_pos = __auart_pos(hauart->tx_size, dst);
+        int32_t src_pos = __auart_pos(hauart->tx_size, src);
+
+        int32_t size_to_move = len;
+        if (size_to_move > hauart->tx_size - dst_pos)
+            size_to_move = hauart->tx_size - dst_pos;
+        if (size_to_move > hauart->tx_size - src_pos)
+            size_to_move = hauart->tx_size - src_pos;
+
+        memmove(hauart->tx_buffer + dst_pos,
+                hauart->tx_buffer + src_pos, size_to_move);
+
+        dst = __auart_tx_wrap(hauart, dst + size_to_move);
+        src = __auart_tx_wrap(hauart, src + size_to_move);
+        len -= size_to_move;
+    }
+}
+
+static int __auart_tx_overwrite(auart_t *hauart, const void *data, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    const uint8_t *pu8data = (const uint8_t *)data;
+
+    if (len <= __auart_get_capacity_in_tx_buffer(hauart))
+        return __auart_tx_partial(hauart, data, len);
+
+    // keep the interrupts from starting a transfer over the pending data,
+    // the ones already running are done by the time the flag is seen.
+    hauart->tx_rewriting = true;
+    __auart_fence();
+
+    int32_t tx_head = __auart_load_acquire(&hauart->tx_head);
+    int32_t tx_tail = __auart_load(&hauart->tx_tail);
+
+    // the data of the running and queued transfers cannot be given back
+    int32_t size_in_dma;
+    while (1)
+    {
+        size_in_dma = 0;
+        if (__auart_load_acquire(&hauart->tx_dma_state) != AUART_TX_DMA_STOPED)
+        {
+            size_in_dma = __auart_load(&hauart->tx_dma_size);
+            size_in_dma += hauart->tx_dma_queued_size;
+        }
+
+        // a transfer completed while we were reading the sizes, the head
+        // has moved and the sizes may belong to the next transfer.
+        int32_t new_tx_head = __auart_load_acquire(&hauart->tx_head);
+        if (new_tx_head == tx_head)
+            break;
+
+        tx_head = new_tx_head;
+    }
+
+    int32_t tx_pending = __auart_tx_wrap(hauart, tx_head + size_in_dma);
+    int32_t size_pending = __auart_dist(hauart->tx_size, tx_pending, tx_tail);
+    int32_t size_free =
+        hauart->tx_size - __auart_dist(hauart->tx_size, tx_head, tx_tail);
+
+    // the data is larger than all we can free, only its end is kept
+    int32_t size_to_write = len;
+    if (size_to_write > size_free + size_pending)
+        size_to_write = size_free + size_pending;
+
+    pu8data += len - size_to_write;
+
+    int32_t size_to_drop = size_to_write - size_free;
+    if (size_to_drop > 0)
+    {
+        __auart_tx_move(hauart, tx_pending,
+                        __auart_tx_wrap(hauart, tx_pending + size_to_drop),
+                        size_pending - size_to_drop);
+
+        tx_tail = __auart_tx_wrap(
+            hauart, tx_tail + hauart->tx_size * 2 - size_to_drop);
+        __auart_store_release(&hauart->tx_tail, tx_tail);
+
+        __auart_stat_add(hauart, AUART_STAT(tx_dropped_bytes), size_to_drop);
+    }
+
+    __auart_stat_add(hauart, AUART_STAT(tx_dropped_bytes),
+                     len - size_to_write);
+
+    auart_span_t spans[2];
+    auart_tx_reserve(hauart, spans);
+    __auart_write_spans(spans, 0, pu8data, size_to_write);
+
+    // pairs with the check in `__auart_tx_dma_continue()`, the commit
+    // below kicks the dma if a transfer was held back.
+    hauart->tx_rewriting = false;
+    __auart_fence();
+
+    return auart_tx_commit(hauart, size_to_write);
+}
+#endif
+
+int auart_tx(auart_t *hauart, const void *data, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    if (hauart->tx_policy == AUART_TX_ALL_OR_NOTHING)
+    {
+        auart_iovec_t iov = {data, len};
+        return auart_txv(hauart, &iov, 1);
+    }
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 0)
+    if (hauart->tx_policy == AUART_TX_OVERWRITE_OLDEST)
+        return __auart_tx_overwrite(hauart, data, len);
+#endif
+
+    if (hauart->tx_policy == AUART_TX_BLOCK)
+        return __auart_tx_block(hauart, data, len, hauart->tx_timeout_ms);
+
+    return __auart_tx_partial(hauart, data, len);
+}
+
+int auart_tx_from_isr(auart_t *hauart, const void *data, int32_t len)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    if (hauart == NULL || data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    if (hauart->tx_policy == AUART_TX_ALL_OR_NOTHING)
+    {
+        auart_iovec_t iov = {data, len};
+        return auart_txv(hauart, &iov, 1);
+    }
+
+    // never waits in an interrupt
+    return __auart_tx_partial(hauart, data, len);
+#else
+    (void)hauart;
+    (void)data;
+    (void)len;
+    return AUART_NOT_SUPPORTED;
+#endif
+}
+
+int auart_txv(auart_t *hauart, const auart_iovec_t *iov, int32_t iovcnt)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || iov == NULL || iovcnt < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    int32_t total_len = 0;
+    for (int32_t i = 0; i < iovcnt; i++)
+    {
+        if (iov[i].len < 0 || (iov[i].len > 0 && iov[i].data == NULL))
+            return AUART_INVALID_ARGUMENT;
+
+        // larger than the TX buffer, can never be sent in one piece
+        if (iov[i].len > hauart->tx_size - total_len)
+            return AUART_INVALID_ARGUMENT;
+
+        total_len += iov[i].len;
+    }
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    return __auart_tx_write(hauart, iov, iovcnt, total_len, false);
+#endif
+
+    auart_span_t spans[2];
+    int res = auart_tx_reserve(hauart, spans);
+    if (res < 0)
+        return res;
+
+    // all or nothing, the frame is never split
+    if (total_len > res)
+    {
+        __auart_stat_add(hauart, AUART_STAT(tx_full_rejects), 1);
+        return 0;
+    }
+
+    if (total_len == 0)
+        return 0;
+
+    int32_t offset = 0;
+    for (int32_t i = 0; i < iovcnt; i++)
+    {
+        __auart_write_spans(spans, offset, iov[i].data, iov[i].len);
+        offset += iov[i].len;
+    }
+
+    return auart_tx_commit(hauart, total_len);
+}
+
+static inline bool __auart_rx_take_overrun(auart_t *hauart)
+{
+    //? this function is in thread context ?//
+
+    uint32_t rx_overrun_count = __auart_load32(&hauart->rx_overrun_count);
+    if (rx_overrun_count == hauart->rx_overrun_reported)
+        return false;
+
+    hauart->rx_overrun_reported = rx_overrun_count;
+    return true;
+}
+
+static inline int __auart_rx_resume(auart_t *hauart)
+{
+    //? this function is in thread context ?//
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_FLOW_CONTROL)
+    if (!__auart_load(&hauart->rx_paused) ||
+        __auart_get_data_size_in_rx_buffer(hauart) > hauart->rx_size / 4)
+        return AUART_OK;
+
+    if (!__auart_cas(&hauart->rx_paused, 1, 0))
+        return AUART_OK;
+
+    int res = hauart->op->rx_flow(hauart->h_rxdma, false);
+
+    // an interrupt paused the sender again before the call above, its
+    // call must be the last one.
+    if (__auart_load(&hauart->rx_paused))
+        res = hauart->op->rx_flow(hauart->h_rxdma, true);
+
+    return res;
+#elif (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+    if (!__auart_load_acquire(&hauart->rx_paused) ||
+        __auart_get_data_size_in_rx_buffer(hauart) != 0)
+        return AUART_OK;
+
+    // the dma is stopped and the interrupts leave the indices alone, the
+    // empty buffer starts over from its beginning.
+    __auart_store(&hauart->rx_head, 0);
+    __auart_store(&hauart->rx_tail, 0);
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+    hauart->rx_frame_start = 0;
+#endif
+
+    // only the port can tell whether anything came in while stopped
+    int is_lost = 0;
+    if (hauart->op->rx_lost != NULL)
+    {
+        is_lost = hauart->op->rx_lost(hauart->h_rxdma);
+        if (is_lost < 0)
+            return is_lost;
+    }
+
+    int res = hauart->op->dma_rx_start(
+        hauart->h_rxdma,
+        hauart->rx_buffer,
+        hauart->rx_size);
+
+    // stays paused, tried again by the next read
+    if (res < 0)
+        return res;
+
+    if (is_lost > 0)
+    {
+        __auart_add32(&hauart->rx_overrun_count, 1);
+        __auart_stat_add(hauart, AUART_STAT(rx_overruns), 1);
+    }
+
+    __auart_store_release(&hauart->rx_paused, 0);
+    return AUART_OK;
+#else
+    (void)hauart;
+    return AUART_OK;
+#endif
+}
+
+static inline void __auart_rx_poll_tail(auart_t *hauart)
+{
+    //? this function is in thread context ?//
+
+#if (CONFIG_AUART_RX_POLL_DMA == 1)
+    uint32_t rx_tail;
+    uint32_t new_rx_tail;
+    int32_t size_received;
+    int32_t size_in_buffer;
+
+    // overruns and pauses are left to the interrupts, the tail only moves
+    // forward when neither is needed. the interrupts run on the next
+    // half, complete or IDLE event anyway.
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_OVERWRITE_OLDEST)
+    const int32_t size_max = hauart->rx_size;
+#else
+    const int32_t size_max = hauart->rx_size / 2;
+#endif
+
+    do
+    {
+        rx_tail = __auart_load(&hauart->rx_tail);
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+        // a stopped dma does not tell a valid position. it can only have
+        // been stopped together with a move of the tail, which fails the
+        // swap below.
+        if (__auart_load_acquire(&hauart->rx_paused))
+            return;
+#endif
+
+        uint32_t rx_dma_transfers_left = 0;
+        if (hauart->op->dma_rx_update_progress(
+                hauart->h_rxdma, &rx_dma_transfers_left) < 0)
+            return;
+
+        int32_t rx_cnt = hauart->rx_size - rx_dma_transfers_left;
+        if (rx_cnt == hauart->rx_size)
+            rx_cnt = 0;
+
+        size_received = rx_cnt;
+        size_received -= __auart_pos(hauart->rx_size, rx_tail);
+        if (size_received < 0)
+            size_received += hauart->rx_size;
+
+        if (size_received == 0)
+            return;
+
+        new_rx_tail = __auart_rx_wrap(hauart, rx_tail + size_received);
+
+        size_in_buffer = __auart_dist(
+            hauart->rx_size, __auart_load(&hauart->rx_head), new_rx_tail);
+        if (size_in_buffer > size_max)
+            return;
+
+    } while (!__auart_cas(&hauart->rx_tail, rx_tail, new_rx_tail));
+
+    __auart_stat_add(hauart, AUART_STAT(rx_bytes), size_received);
+    __auart_stat_max(hauart, AUART_STAT(rx_high_water), size_in_buffer);
+#else
+    (void)hauart;
+#endif
+}
+
+static inline bool __auart_rx_skip_lapped(auart_t *hauart, uint32_t rx_head)
+{
+    //? this function is in thread context ?//
+
+    // like a seqlock, the data from `rx_head` on was read first and is only
+    // valid if the dma has not written over it since. the interrupts may
+    // not have seen the dma lap the reader yet, but the dma is never more
+    // than a buffer ahead of the tail, they see at least every half of it.
+    __auart_fence();
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+    // a stopped dma does not tell a valid position, nor does it write
+    if (__auart_load_acquire(&hauart->rx_paused))
+        return false;
+#endif
+
+    uint32_t rx_tail = __auart_load_acquire(&hauart->rx_tail);
+
+    uint32_t rx_dma_transfers_left = 0;
+    if (hauart->op->dma_rx_update_progress(
+            hauart->h_rxdma, &rx_dma_transfers_left) < 0)
+        return false;
+
+    int32_t rx_cnt = hauart->rx_size - rx_dma_transfers_left;
+    if (rx_cnt == hauart->rx_size)
+        rx_cnt = 0;
+
+    int32_t size_ahead = rx_cnt - __auart_pos(hauart->rx_size, rx_tail);
+    if (size_ahead < 0)
+        size_ahead += hauart->rx_size;
+
+    uint32_t rx_dma = __auart_rx_wrap(hauart, rx_tail + size_ahead);
+
+    int32_t size_lost = __auart_dist(hauart->rx_size, rx_head, rx_dma);
+    size_lost -= hauart->rx_size;
+    if (size_lost <= 0)
+        return false;
+
+    // skip the overwritten data, unless an interrupt did meanwhile
+    if (__auart_cas(&hauart->rx_head, rx_head,
+                    __auart_rx_wrap(hauart, rx_head + size_lost)))
+    {
+        __auart_add32(&hauart->rx_overrun_count, 1);
+        __auart_stat_add(hauart, AUART_STAT(rx_overruns), 1);
+        __auart_stat_add(hauart, AUART_STAT(rx_lost_bytes), size_lost);
+    }
+
+    return true;
+}
+
+int auart_rx_peek(auart_t *hauart, auart_span_t spans[2])
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || spans == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    int res = __auart_rx_resume(hauart);
+    if (res < 0)
+        return res;
+
+    if (__auart_rx_take_overrun(hauart))
+        return AUART_OVERRUN;
+
+    __auart_rx_poll_tail(hauart);
+
+    int32_t rx_head_pos = __auart_pos(
+        hauart->rx_size, __auart_load(&hauart->rx_head));
+    int32_t size_in_buffer = __auart_get_data_size_in_rx_buffer(hauart);
+    int32_t size_to_end = hauart->rx_size - rx_head_pos;
+
+    spans[0].data = hauart->rx_buffer + rx_head_pos;
+    spans[1].data = hauart->rx_buffer;
+
+    if (size_in_buffer <= size_to_end)
+    {
+        spans[0].len = size_in_buffer;
+        spans[1].len = 0;
+    }
+    else
+    {
+        spans[0].len = size_to_end;
+        spans[1].len = size_in_buffer - size_to_end;
+    }
+
+    return size_in_buffer;
+}
+
+int auart_rx_consume(auart_t *hauart, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    // the data peeked before may have been overwritten
+    if (__auart_rx_take_overrun(hauart))
+        return AUART_OVERRUN;
+
+    int32_t rx_head = __auart_load(&hauart->rx_head);
+    int32_t size_in_buffer = __auart_get_data_size_in_rx_buffer(hauart);
+
+    // the data peeked before may have been overwritten since
+    if (__auart_rx_skip_lapped(hauart, rx_head))
+    {
+        __auart_rx_take_overrun(hauart);
+        return AUART_OVERRUN;
+    }
+
+    int32_t size_to_consume = len;
+    if (size_to_consume > size_in_buffer)
+        size_to_consume = size_in_buffer;
+
+    int32_t new_head = __auart_rx_wrap(hauart, rx_head + size_to_consume);
+
+    // an interrupt skipped the overwritten data meanwhile
+    if (!__auart_cas(&hauart->rx_head, rx_head, new_head))
+    {
+        __auart_rx_take_overrun(hauart);
+        return AUART_OVERRUN;
+    }
+
+    int res = __auart_rx_resume(hauart);
+    if (res < 0)
+        return res;
+
+    return size_to_consume;
+}
+
+int auart_rx(auart_t *hauart, void *data, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    if (data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    auart_span_t spans[2];
+    int res = auart_rx_peek(hauart, spans);
+    if (res <= 0)
+        return res;
+
+    int32_t size_to_copy = len;
+    if (size_to_copy > res)
+        size_to_copy = res;
+
+    int32_t size_first_copy = size_to_copy;
+    if (size_first_copy > spans[0].len)
+        size_first_copy = spans[0].len;
+
+    memcpy(data, spans[0].data, size_first_copy);
+
+    int32_t size_second_copy = size_to_copy - size_first_copy;
+    if (size_second_copy != 0)
+        memcpy((uint8_t *)data + size_first_copy, spans[1].data, size_second_copy);
+
+    return auart_rx_consume(hauart, size_to_copy);
+}
+
+static inline int32_t __auart_find_byte(
+    const uint8_t *pdata, int32_t len, uint8_t c)
+{
+    int32_t i = 0;
+
+    // byte by byte until the pointer is word aligned
+    while (i < len && ((uintptr_t)(pdata + i) & (sizeof(uint32_t) - 1)))
+    {
+        if (pdata[i] == c)
+            return i;
+        i++;
+    }
+
+    // then a word at a time, a byte of `x` is zero where it matches `c`
+    const uint32_t ones = 0x01010101u;
+    const uint32_t highs = 0x80808080u;
+    uint32_t pattern = ones * c;
+
+    for (; i + (int32_t)sizeof(uint32_t) <= len; i += sizeof(uint32_t))
+    {
+        // memcpy instead of a cast, the buffer is not a uint32_t object.
+        // it is a single aligned load once optimized.
+        uint32_t x;
+        memcpy(&x, pdata + i, sizeof(x));
+        x ^= pattern;
+        if ((x - ones) & ~x & highs)
+            break;
+    }
+
+    for (; i < len; i++)
+    {
+        if (pdata[i] == c)
+            return i;
+    }
+
+    return -1;
+}
+
+int auart_rx_find(auart_t *hauart, uint8_t delim)
+{
+    //? this function is in thread context ?//
+
+    auart_span_t spans[2];
+    int res = auart_rx_peek(hauart, spans);
+    if (res <= 0)
+        return res;
+
+    int32_t pos = __auart_find_byte(spans[0].data, spans[0].len, delim);
+    if (pos >= 0)
+        return pos + 1;
+
+    pos = __auart_find_byte(spans[1].data, spans[1].len, delim);
+    if (pos >= 0)
+        return spans[0].len + pos + 1;
+
+    return 0;
+}
+
+int auart_rx_until(auart_t *hauart, uint8_t delim, void *data, int32_t len)
+{
+    //? this function is in thread context ?//
+
+    if (data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    int res = auart_rx_find(hauart, delim);
+    if (res < 0)
+        return res;
+
+    // no delimiter yet, only return data when the caller's buffer is full
+    if (res == 0 && __auart_get_data_size_in_rx_buffer(hauart) < len)
+        return 0;
+
+    int32_t size_to_read = len;
+    if (res != 0 && res < size_to_read)
+        size_to_read = res;
+
+    return auart_rx(hauart, data, size_to_read);
+}
+
+static inline void __auart_rx_skip_overwritten(
+    auart_t *hauart, uint32_t new_rx_tail)
+{
+    //? this function is in IRQ context ?//
+
+    uint32_t rx_head;
+    int32_t size_lost;
+
+    // the dma has lapped the head, the oldest bytes are gone. the reader
+    // may be consuming at the same time, its swap fails if we win.
+    do
+    {
+        rx_head = __auart_load(&hauart->rx_head);
+
+        size_lost = __auart_dist(hauart->rx_size, rx_head, new_rx_tail);
+        size_lost -= hauart->rx_size;
+        if (size_lost <= 0)
+            return;
+
+    } while (!__auart_cas(&hauart->rx_head, rx_head,
+                          __auart_rx_wrap(hauart, rx_head + size_lost)));
+
+    __auart_add32(&hauart->rx_overrun_count, 1);
+    __auart_stat_add(hauart, AUART_STAT(rx_overruns), 1);
+    __auart_stat_add(hauart, AUART_STAT(rx_lost_bytes), size_lost);
+}
+
+static inline void __auart_rx_pause(auart_t *hauart, int32_t size_in_buffer)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY != AUART_RX_OVERRUN_OVERWRITE_OLDEST)
+    // the next half of the buffer may not fit anymore
+    if (size_in_buffer <= hauart->rx_size / 2)
+        return;
+
+    if (!__auart_cas(&hauart->rx_paused, 0, 1))
+        return;
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_FLOW_CONTROL)
+    hauart->op->rx_flow(hauart->h_rxdma, true);
+#else
+    // the bytes written since the progress was read are dropped as well
+    hauart->op->dma_rx_abort(hauart->h_rxdma);
+#endif
+#else
+    (void)hauart;
+    (void)size_in_buffer;
+#endif
+}
+
+static inline int __auart_rx_update_tail(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+
+    uint32_t rx_tail;
+    uint32_t new_rx_tail;
+    int32_t size_received;
+
+    // the idle and the dma interrupts may preempt each other, the progress
+    // is read again if the tail moved meanwhile.
+    do
+    {
+        rx_tail = __auart_load(&hauart->rx_tail);
+
+        uint32_t rx_dma_transfers_left = 0;
+
+        int res = hauart->op->dma_rx_update_progress(
+            hauart->h_rxdma,
+            &rx_dma_transfers_left);
+
+        if (res < 0)
+            return res;
+
+        // in circular mode the counter reloads to rx_size after reaching
+        // zero, so `rx_cnt` is in the range of [0, rx_size].
+        int32_t rx_cnt = hauart->rx_size - rx_dma_transfers_left;
+        if (rx_cnt == hauart->rx_size)
+            rx_cnt = 0;
+
+        // the dma only tells a position, the tail moves forward to it.
+        size_received = rx_cnt;
+        size_received -= __auart_pos(hauart->rx_size, rx_tail);
+        if (size_received < 0)
+            size_received += hauart->rx_size;
+
+        new_rx_tail = __auart_rx_wrap(hauart, rx_tail + size_received);
+
+        // the head must be moved first, the tail never gets more than the
+        // size of the buffer ahead of it.
+        __auart_rx_skip_overwritten(hauart, new_rx_tail);
+
+    } while (!__auart_cas(&hauart->rx_tail, rx_tail, new_rx_tail));
+
+    int32_t size_in_buffer = __auart_get_data_size_in_rx_buffer(hauart);
+
+    __auart_stat_add(hauart, AUART_STAT(rx_bytes), size_received);
+    __auart_stat_max(hauart, AUART_STAT(rx_high_water), size_in_buffer);
+
+    __auart_rx_pause(hauart, size_in_buffer);
+
+    return 0;
+}
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+// `rx_frame_lock`, a close in progress and the events posted to it
+#define AUART_RX_FRAME_BUSY 0x1
+#define AUART_RX_FRAME_IDLE 0x2
+#define AUART_RX_FRAME_EVENT 0x4
+
+static inline void __auart_rx_frame_close_locked(auart_t *hauart, bool is_idle)
+{
+    //? this function is in IRQ context ?//
+
+    uint32_t rx_tail = __auart_load(&hauart->rx_tail);
+    uint32_t rx_head = __auart_load_acquire(&hauart->rx_head);
+    uint32_t frame_start = hauart->rx_frame_start;
+
+    // the dma overwrote the beginning of the frame, or the reader already
+    // took it with `auart_rx()`.
+    if (__auart_dist(hauart->rx_size, frame_start, rx_tail) >
+        __auart_dist(hauart->rx_size, rx_head, rx_tail))
+        frame_start = rx_head;
+
+    uint32_t frame_len = __auart_dist(hauart->rx_size, frame_start, rx_tail);
+
+    if (frame_len == 0)
+        return;
+
+    // on a half or complete event, only split bursts that are about to
+    // become longer than the RX buffer.
+    if (!is_idle && frame_len < (uint32_t)hauart->rx_size / 2)
+        return;
+
+    hauart->rx_frame_start = rx_tail;
+
+    uint32_t frame_tail = __auart_load(&hauart->rx_frame_tail);
+    uint32_t new_frame_tail = frame_tail + 1;
+    if (new_frame_tail == CONFIG_AUART_RX_FRAME_QUEUE_SIZE)
+        new_frame_tail = 0;
+
+    // the queue is full, the frame is dropped
+    if (new_frame_tail == __auart_load_acquire(&hauart->rx_frame_head))
+        return;
+
+    auart_rx_frame_t *frame = &hauart->rx_frames[frame_tail];
+    frame->start = frame_start;
+    frame->len = frame_len;
+    frame->tick = __auart_get_tick_ms(hauart);
+
+    __auart_store_release(&hauart->rx_frame_tail, new_frame_tail);
+}
+#endif
+
+static inline void __auart_rx_frame_close(auart_t *hauart, bool is_idle)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+    // the idle, dma and tick interrupts may preempt each other. the first
+    // one in owns the frame state, the nested ones only post their event
+    // and the owner closes the frame for them before it leaves.
+    uint32_t event = is_idle ? AUART_RX_FRAME_IDLE : AUART_RX_FRAME_EVENT;
+    uint32_t lock;
+
+    do
+    {
+        lock = __auart_load(&hauart->rx_frame_lock);
+    } while (!__auart_cas(&hauart->rx_frame_lock,
+                          lock, lock | event | AUART_RX_FRAME_BUSY));
+
+    if (lock & AUART_RX_FRAME_BUSY)
+        return;
+
+    do
+    {
+        // take the events posted so far
+        do
+        {
+            lock = __auart_load(&hauart->rx_frame_lock);
+        } while (!__auart_cas(&hauart->rx_frame_lock,
+                              lock, AUART_RX_FRAME_BUSY));
+
+        __auart_rx_frame_close_locked(hauart, lock & AUART_RX_FRAME_IDLE);
+
+        // fails if an event was posted meanwhile
+    } while (!__auart_cas(&hauart->rx_frame_lock, AUART_RX_FRAME_BUSY, 0));
+#else
+    (void)hauart;
+    (void)is_idle;
+#endif
+}
+
+static inline int __auart_rx_event(auart_t *hauart, bool is_idle)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+    // the dma is stopped, the reader restarts it
+    if (__auart_load_acquire(&hauart->rx_paused))
+        return AUART_OK;
+#endif
+
+    int res = __auart_rx_update_tail(hauart);
+    __auart_rx_frame_close(hauart, is_idle);
+    __auart_notify_event(hauart);
+
+    return res;
+}
+
+int auart_idle_callback(auart_t *hauart)
+{
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    __auart_stat_add(hauart, AUART_STAT(idle_events), 1);
+
+    return __auart_rx_event(hauart, true);
+}
+
+int auart_dma_rx_half_cplt_callback(auart_t *hauart)
+{
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    __auart_stat_add(hauart, AUART_STAT(rx_half_events), 1);
+
+    return __auart_rx_event(hauart, false);
+}
+
+int auart_dma_rx_cplt_callback(auart_t *hauart)
+{
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    __auart_stat_add(hauart, AUART_STAT(rx_cplt_events), 1);
+
+    return __auart_rx_event(hauart, false);
+}
+
+static inline int __auart_rx_tick(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_TICK_LATENCY_MS > 0)
+    uint32_t now = __auart_get_tick_ms(hauart);
+    if (now - hauart->rx_tick_last < CONFIG_AUART_TICK_LATENCY_MS)
+        return AUART_OK;
+
+    hauart->rx_tick_last = now;
+#endif
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+    if (__auart_load_acquire(&hauart->rx_paused))
+        return AUART_OK;
+#endif
+
+    uint32_t rx_dma_transfers_left = 0;
+    int res = hauart->op->dma_rx_update_progress(
+        hauart->h_rxdma,
+        &rx_dma_transfers_left);
+
+    if (res < 0)
+        return res;
+
+    int32_t rx_cnt = hauart->rx_size - rx_dma_transfers_left;
+    if (rx_cnt == hauart->rx_size)
+        rx_cnt = 0;
+
+    // the dma has not moved since the tail was last updated
+    if (rx_cnt == __auart_pos(hauart->rx_size, __auart_load(&hauart->rx_tail)))
+        return AUART_OK;
+
+    return __auart_rx_event(hauart, false);
+}
+
+static inline int __auart_tx_tick(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+
+#if (CONFIG_AUART_TX_COALESCE_HOLD_MS > 0)
+    // the hold is otherwise only checked by the next commit
+    if (!hauart->tx_holding ||
+        __auart_get_tick_ms(hauart) - hauart->tx_hold_tick <
+            CONFIG_AUART_TX_COALESCE_HOLD_MS)
+        return AUART_OK;
+
+    return __auart_tx_dma_kick(hauart);
+#else
+    (void)hauart;
+    return AUART_OK;
+#endif
+}
+
+int auart_tick(auart_t *hauart)
+{
+    //? this function is in IRQ context ?//
+
+    if (hauart == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    int res = AUART_OK;
+
+    if (__auart_has_rx(hauart))
+        res = __auart_rx_tick(hauart);
+
+    if (__auart_has_tx(hauart))
+    {
+        int tx_res = __auart_tx_tick(hauart);
+        if (res == AUART_OK)
+            res = tx_res;
+    }
+
+    return res;
+}
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+int auart_rx_frame(auart_t *hauart, void *data, int32_t len,
+                   uint32_t *out_tick)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_rx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    int res = __auart_rx_resume(hauart);
+    if (res < 0)
+        return res;
+
+    uint32_t rx_head = __auart_load(&hauart->rx_head);
+
+    // the queued frames may have been overwritten, drop them all
+    if (__auart_rx_take_overrun(hauart))
+    {
+        __auart_store_release(&hauart->rx_frame_head,
+                              __auart_load_acquire(&hauart->rx_frame_tail));
+        return AUART_OVERRUN;
+    }
+
+    uint32_t frame_head = __auart_load(&hauart->rx_frame_head);
+    if (frame_head == __auart_load_acquire(&hauart->rx_frame_tail))
+        return 0;
+
+    auart_rx_frame_t *frame = &hauart->rx_frames[frame_head];
+
+    int32_t size_to_copy = len;
+    if ((uint32_t)size_to_copy > frame->len)
+        size_to_copy = frame->len;
+
+    int32_t frame_pos = __auart_pos(hauart->rx_size, frame->start);
+    int32_t size_to_end = hauart->rx_size - frame_pos;
+
+    int32_t size_first_copy = size_to_copy;
+    if (size_first_copy > size_to_end)
+        size_first_copy = size_to_end;
+
+    memcpy(data, hauart->rx_buffer + frame_pos, size_first_copy);
+
+    int32_t size_second_copy = size_to_copy - size_first_copy;
+    if (size_second_copy != 0)
+        memcpy((uint8_t *)data + size_first_copy, hauart->rx_buffer, size_second_copy);
+
+    if (out_tick != NULL)
+        *out_tick = frame->tick;
+
+    // release the whole frame, including the part that did not fit
+    uint32_t new_head = frame->start + frame->len;
+    new_head = __auart_rx_wrap(hauart, new_head);
+
+    // the dma may have written over the frame while it was copied, or an
+    // interrupt skipped the overwritten data meanwhile
+    if (__auart_rx_skip_lapped(hauart, rx_head) ||
+        !__auart_cas(&hauart->rx_head, rx_head, new_head))
+    {
+        __auart_rx_take_overrun(hauart);
+        __auart_store_release(&hauart->rx_frame_head,
+                              __auart_load_acquire(&hauart->rx_frame_tail));
+        return AUART_OVERRUN;
+    }
+
+    uint32_t new_frame_head = frame_head + 1;
+    if (new_frame_head == CONFIG_AUART_RX_FRAME_QUEUE_SIZE)
+        new_frame_head = 0;
+
+    __auart_store_release(&hauart->rx_frame_head, new_frame_head);
+
+    return size_to_copy;
+}
+#endif
+
+int auart_get_stats(auart_t *hauart, auart_stats_t *stats)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || stats == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+#if (CONFIG_AUART_STATS == 1)
+    uint32_t *pstats = (uint32_t *)stats;
+    const int32_t num_stats = sizeof(auart_stats_t) / sizeof(uint32_t);
+
+    for (int32_t retry = 0; retry < AUART_STATS_MAX_RETRIES; retry++)
+    {
+        uint32_t seq = __auart_load32(&hauart->stats_seq);
+
+        // a writer is inside, possibly one we preempted
+        if (seq & AUART_STATS_WRITER_COUNT_MASK)
+            continue;
+
+        __auart_fence();
+
+        for (int32_t i = 0; i < num_stats; i++)
+            pstats[i] = __auart_load32(&hauart->stats[i]);
+
+        __auart_fence();
+
+        if (__auart_load32(&hauart->stats_seq) == seq)
+            return AUART_OK;
+    }
+
+    return AUART_BUSY;
+#else
+    return AUART_NOT_SUPPORTED;
+#endif
+}
+
+static int __auart_tx_flush(auart_t *hauart, uint32_t timeout_ms)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL)
+        return AUART_INVALID_ARGUMENT;
+
+    uint32_t start_tick = __auart_get_tick_ms(hauart);
+
+    while (1)
+    {
+        // also restarts the data held back by the coalescing window or
+        // left behind by a failed dma start.
+        int res = auart_tx_kick(hauart);
+        if (res < 0)
+            return res;
+
+        uint32_t tx_dma_state = __auart_load(&hauart->tx_dma_state);
+        uint32_t tx_head = __auart_load_acquire(&hauart->tx_head);
+        uint32_t tx_tail = __auart_load(&hauart->tx_tail);
+
+        if (tx_dma_state == AUART_TX_DMA_STOPED && tx_head == tx_tail)
+            return AUART_OK;
+
+        res = __auart_wait_event(hauart, start_tick, timeout_ms);
+        if (res < 0)
+            return res;
+    }
+}
+
+int auart_tx_flush(auart_t *hauart)
+{
+    return __auart_tx_flush(hauart, AUART_WAIT_FOREVER);
+}
+
+#if (CONFIG_AUART_USE_TIME_API == 1)
+int auart_tx_flush_timeout(auart_t *hauart, uint32_t timeout_ms)
+{
+    return __auart_tx_flush(hauart, timeout_ms);
+}
+
+int auart_tx_timeout(auart_t *hauart, const void *data, int32_t len,
+                     uint32_t timeout_ms)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    if (!__auart_has_tx(hauart))
+        return AUART_NOT_SUPPORTED;
+
+    return __auart_tx_block(hauart, data, len, timeout_ms);
+}
+
+int auart_rx_timeout(auart_t *hauart, void *data, int32_t len,
+                     uint32_t timeout_ms)
+{
+    //? this function is in thread context ?//
+
+    if (hauart == NULL || data == NULL || len < 0)
+        return AUART_INVALID_ARGUMENT;
+
+    uint32_t start_tick = __auart_get_tick_ms(hauart);
+
+    while (1)
+    {
+        int res = auart_rx(hauart, data, len);
+        if (res != 0 || len == 0)
+            return res;
+
+        res = __auart_wait_event(hauart, start_tick, timeout_ms);
+        if (res == AUART_TIMEOUT)
+            return 0;
+
+        if (res < 0)
+            return res;
+    }
+}
+#endif
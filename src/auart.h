@@ -10,12 +10,14 @@
  * ==================================
  *           How to use:
  * ==================================
- * 1. Fill the auart_init_t structure and call auart_init() to initialize
- *    the AUART.
- * 2. Call auart_dma_cplt_callback in the corresponding DMA interrupt.
- * 3. Call auart_dma_half_cplt_callback in the corresponding DMA interrupt.
+ * 1. Fill a const auart_ops_t table, shared by all the ports using the
+ *    same DMA, then fill the auart_init_t structure of each port and call
+ *    auart_init() to initialize the AUART.
+ * 2. Call auart_dma_rx_cplt_callback in the corresponding DMA interrupt.
+ * 3. Call auart_dma_rx_half_cplt_callback in the corresponding DMA interrupt.
  * 4. Call auart_idle_callback in the corresponding UART interrupt.
- * 5. enjoy the auart_tx and auart_rx functions!
+ * 5. Call auart_tx_cplt_callback in the corresponding DMA interrupt.
+ * 6. enjoy the auart_tx and auart_rx functions!
  *
  *
  * @note ALL API in this file has same return value convention:
@@ -34,8 +36,16 @@
 #ifndef __AUART_H__
 #define __AUART_H__
 
+#if (CONFIG_AUART_USE_C11_ATOMICS == 1)
+#include <stdatomic.h>
+#endif
+
 /**
- * @brief The initialization structure of the AUART
+ * @brief The operations of the AUART, shared by all the ports of the same
+ * type.
+ *
+ * The driver keeps a pointer to this table, so it should be declared
+ * `static const` to stay in flash.
  */
 typedef struct
 {
@@ -48,8 +58,8 @@ typedef struct
      * `dma_rx_start()` function.
      *
      * this function will be called by the driver in the DMA half and complete
-     * interrupt, the UART IDLE interrupt and also in the `auart_rx()`
-     * function.
+     * interrupt, the UART IDLE interrupt and, with CONFIG_AUART_RX_POLL_DMA,
+     * also by the RX functions in thread context.
      *
      * @param hdma the handle of the DMA
      * @param out_bytes_left the number of bytes left to be received
@@ -64,12 +74,24 @@ typedef struct
     /**
      * @brief this callback is used by the driver to start the RX DMA.
      *
+     * the DMA must be configured in circular mode, it is started by
+     * `auart_init()` over the whole RX buffer and is only restarted after
+     * being stopped by AUART_RX_OVERRUN_DROP_NEWEST.
+     *
      * @param hdma the handle of the DMA
      * @param pdst the destination buffer
      * @param len the number of bytes to be received
      *
      * @return <0: Error, =0: Success
      *
+     * @note the half transfer and transfer complete interrupts of the DMA
+     * should be enabled, see `auart_dma_rx_half_cplt_callback()` and
+     * `auart_dma_rx_cplt_callback()`.
+     *
+     * @note a DMA with a double buffer mode can use the two halves of the
+     * buffer as its two memory targets instead. the end of the first half
+     * is then reported as the half transfer, and `dma_rx_update_progress()`
+     * counts the bytes left up to the end of the second half.
      */
     int (*dma_rx_start)(void *hdma, void *pdst, uint32_t len);
 
@@ -81,10 +103,45 @@ typedef struct
      * @return <0: Error, =0: Success
      *
      * @note this function is called by the driver in the `auart_deinit()`
-     * function.
+     * function, and when AUART_RX_OVERRUN_DROP_NEWEST stops the RX.
      */
     int (*dma_rx_abort)(void *hdma);
 
+    /**
+     * @brief this callback is used by the driver to pause and resume the
+     * sender, e.g. by driving the RTS line.
+     *
+     * it is called in both thread and IRQ context.
+     *
+     * this function is required with AUART_RX_OVERRUN_FLOW_CONTROL and
+     * unused otherwise.
+     *
+     * @param hdma the handle of the RX DMA
+     * @param is_paused true to stop the sender, false to let it go on
+     *
+     * @return <0: Error, =0: Success
+     */
+    int (*rx_flow)(void *hdma, bool is_paused);
+
+    /**
+     * @brief this callback is used by the driver to know whether bytes
+     * arrived while the RX DMA was stopped by AUART_RX_OVERRUN_DROP_NEWEST.
+     *
+     * it is called in thread context, right before the RX DMA is started
+     * again. the port should clear the condition it reports.
+     *
+     * this function is optional and can be set to NULL, in that case the
+     * restart reports no loss. it is unused with the other policies.
+     *
+     * @param hdma the handle of the RX DMA
+     *
+     * @return <0: Error, =0: nothing was lost, >0: bytes were lost
+     *
+     * @note for example, in STM32 ports, this function can check the RXNE
+     * and ORE flags of the UART.
+     */
+    int (*rx_lost)(void *hdma);
+
     /**
      * @brief this callback is used by the driver to start the TX DMA.
      *
@@ -109,6 +166,59 @@ typedef struct
      */
     int (*dma_tx_abort)(void *hdma);
 
+    /**
+     * @brief this callback is used by the driver to check the progress of
+     * the TX DMA. User should implement this function to return the number
+     * of bytes left to be sent.
+     *
+     * the total number of bytes is given by the len parameter of the
+     * `dma_tx_start()` function.
+     *
+     * this function is optional and can be set to NULL. When provided, the
+     * bytes already sent are given back to the TX buffer before the
+     * transfer complete interrupt, so `auart_tx()` sees more free space.
+     *
+     * @param hdma the handle of the DMA
+     * @param out_bytes_left the number of bytes left to be sent
+     *
+     * @return <0: Error, =0: Success
+     *
+     * @note for example, in STM32 ports, this function can be implemented
+     * by reading the NDTR register of the DMA.
+     */
+    int (*dma_tx_update_progress)(void *hdma, uint32_t *out_bytes_left);
+
+    /**
+     * @brief this callback is used by the driver to queue a TX transfer
+     * behind the running one.
+     *
+     * the queued transfer must be started as soon as the running one is
+     * finished, without waiting for software, so there is no idle gap on
+     * the line when the data wraps around the TX buffer. the port calls
+     * `auart_tx_cplt_callback()` once for each of the two transfers.
+     *
+     * this function is optional and can be set to NULL, in that case the
+     * next transfer is started from `auart_tx_cplt_callback()`.
+     *
+     * this function is called from `auart_tx_cplt_callback()` while a
+     * transfer is running, and right before `dma_tx_start()` when the data
+     * to send wraps around the TX buffer. the transfer is then queued
+     * behind the one about to start. no other transfer is queued in
+     * either case. if that `dma_tx_start()` fails, `dma_tx_abort()` is
+     * called and must drop the queued transfer too.
+     *
+     * @param hdma the handle of the DMA
+     * @param psrc the source buffer
+     * @param len the number of bytes to be sent
+     *
+     * @return <0: Error, =0: Success
+     *
+     * @note on STM32 ports without a usable double buffer mode, this can
+     * be implemented by latching `psrc` and `len` and reprogramming the
+     * stream at the very top of the DMA transfer complete interrupt.
+     */
+    int (*dma_tx_queue)(void *hdma, const void *psrc, uint32_t len);
+
 #if (CONFIG_AUART_USE_TIME_API == 1)
     /**
      * @brief This function is used by the driver get current timestamp
@@ -124,42 +234,320 @@ typedef struct
     uint32_t (*get_tick_ms)(void);
 #endif
 
+    /**
+     * @brief this callback is used by the driver to sleep until something
+     * happens on the port, instead of busy polling.
+     *
+     * it is called in thread context by the blocking functions like
+     * `auart_tx_flush()`. it should return once `notify_event()` has been
+     * called, or once `timeout_ms` has passed. returning earlier is fine,
+     * the driver always checks its state again.
+     *
+     * a notification happening before the wait must not be lost, or must
+     * be covered by a periodic wake up such as the SysTick interrupt.
+     *
+     * this function is optional and can be set to NULL, in that case the
+     * driver busy polls.
+     *
+     * @param h_event the event handle
+     * @param timeout_ms the maximum time to wait, or AUART_WAIT_FOREVER
+     *
+     * @return <0: Error, =0: Success
+     *
+     * @note for example, this can be `__WFI()` on bare metal, a semaphore
+     * take on an RTOS, or a condition variable on a host.
+     */
+    int (*wait_event)(void *h_event, uint32_t timeout_ms);
+
+    /**
+     * @brief this callback is used by the driver to wake up a
+     * `wait_event()` call.
+     *
+     * it is called in IRQ context whenever a TX transfer completes or RX
+     * data arrives.
+     *
+     * this function is optional and can be set to NULL.
+     *
+     * @param h_event the event handle
+     */
+    void (*notify_event)(void *h_event);
+
+    /**
+     * @brief this callback is used by the driver to request a call to
+     * `auart_deferred_handler()`.
+     *
+     * it is called in both thread and IRQ context, and must only pend the
+     * handler, e.g. by setting the PendSV bit. requests made while the
+     * handler is already pending may be merged into a single call.
+     *
+     * this function is required with CONFIG_AUART_TX_DEFERRED_KICK and
+     * unused otherwise.
+     *
+     * @param h_deferred the deferred handler handle
+     */
+    void (*pend_deferred)(void *h_deferred);
+
+} auart_ops_t;
+
+/**
+ * @brief The directions a port is used in.
+ *
+ * A one way port leaves the callbacks, handle and buffer of the other
+ * direction unset, its DMA channel is never touched and the functions of
+ * that direction return AUART_NOT_SUPPORTED.
+ */
+typedef enum
+{
+    AUART_DIR_BOTH = 0,
+    AUART_DIR_TX_ONLY,
+    AUART_DIR_RX_ONLY,
+} auart_dir_t;
+
+/**
+ * @brief What `auart_tx()` does when the data does not fit in the TX
+ * buffer.
+ */
+typedef enum
+{
+    // queue what fits and return the short count
+    AUART_TX_PARTIAL = 0,
+
+    // queue nothing and return 0, a message is never split. data larger
+    // than the whole buffer is rejected like `auart_txv()` does.
+    AUART_TX_ALL_OR_NOTHING,
+
+    // drop the oldest data not handed to the DMA yet to make room, the
+    // producer never waits. meant for lossy streams like logs. not
+    // available with `CONFIG_AUART_TX_MULTI_PRODUCER`.
+    AUART_TX_OVERWRITE_OLDEST,
+
+    // wait for room up to `tx_timeout_ms`, like `auart_tx_timeout()`
+    AUART_TX_BLOCK,
+} auart_tx_policy_t;
+
+/**
+ * @brief The initialization structure of the AUART
+ */
+typedef struct
+{
+    // the operations of the port, must outlive the port
+    const auart_ops_t *ops;
+
+    // AUART_DIR_BOTH if left zeroed
+    auart_dir_t dir;
+
+    // AUART_TX_PARTIAL if left zeroed
+    auart_tx_policy_t tx_policy;
+
+    // only used by AUART_TX_BLOCK, 0 does not wait. only 0 and
+    // AUART_WAIT_FOREVER without CONFIG_AUART_USE_TIME_API.
+    uint32_t tx_timeout_ms;
+
     void *h_rxdma;
     void *h_txdma;
+    void *h_event;
+    void *h_deferred;
+
+    /**
+     * @brief the ring buffers of the port.
+     *
+     * each port can bring its own buffers, sized for its own traffic. if a
+     * buffer is NULL, the built-in one of CONFIG_AUART_TX_BUFFER_SIZE or
+     * CONFIG_AUART_RX_BUFFER_SIZE bytes is used and the size is ignored.
+     */
+    uint8_t *tx_buffer;
+    int32_t tx_buffer_size;
+    uint8_t *rx_buffer;
+    int32_t rx_buffer_size;
 
 } auart_init_t;
 
+/**
+ * @brief Pass as `timeout_ms` to wait without a time limit.
+ */
+#define AUART_WAIT_FOREVER 0xFFFFFFFFu
+
+/**
+ * @brief A contiguous region inside one of the AUART ring buffers.
+ *
+ * The ring buffers may wrap around, so the APIs working on spans always
+ * hand out two of them. The second one is empty (`len == 0`) when the
+ * region does not wrap.
+ */
+typedef struct
+{
+    uint8_t *data;
+    int32_t len;
+} auart_span_t;
+
+/**
+ * @brief One segment of a scattered buffer, see `auart_txv()`.
+ */
+typedef struct
+{
+    const void *data;
+    int32_t len;
+} auart_iovec_t;
+
+/**
+ * @brief The counters of a port, see `auart_get_stats()`.
+ *
+ * The counters wrap around, only their differences are meaningful.
+ */
+typedef struct
+{
+    uint32_t rx_bytes;         // bytes received by the RX DMA
+    uint32_t tx_bytes;         // bytes sent by the TX DMA
+    uint32_t tx_dma_starts;    // TX transfers started or queued
+    uint32_t idle_events;      // calls of `auart_idle_callback()`
+    uint32_t rx_half_events;   // calls of `auart_dma_rx_half_cplt_callback()`
+    uint32_t rx_cplt_events;   // calls of `auart_dma_rx_cplt_callback()`
+    uint32_t rx_overruns;      // times unread data has been lost
+    uint32_t rx_lost_bytes;    // bytes overwritten before being read
+    uint32_t tx_full_rejects;  // writes cut short by a full TX buffer
+    uint32_t tx_dropped_bytes; // bytes dropped by AUART_TX_OVERWRITE_OLDEST
+    uint32_t rx_high_water;    // most bytes ever waiting in the RX buffer
+    uint32_t tx_high_water;    // most bytes ever waiting in the TX buffer
+} auart_stats_t;
+
+/**
+ * @brief An index of a ring buffer, as narrow as
+ * CONFIG_AUART_MAX_BUFFER_SIZE allows.
+ *
+ * The indices run over twice the size of the buffer, the extra bit tells
+ * a full buffer from an empty one.
+ */
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_MAX_BUFFER_SIZE <= 0x80)
+#define AUART_INDEX_WIDTH 8
+typedef uint8_t auart_index_t;
+#elif (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && \
+    (CONFIG_AUART_MAX_BUFFER_SIZE <= 0x8000)
+#define AUART_INDEX_WIDTH 16
+typedef uint16_t auart_index_t;
+#else
+#define AUART_INDEX_WIDTH 32
+typedef uint32_t auart_index_t;
+#endif
+
+/**
+ * @brief A received frame, see `auart_rx_frame()`.
+ */
+typedef struct
+{
+    auart_index_t start; // index of the first byte in the RX buffer
+    auart_index_t len;   // number of bytes in the frame
+    uint32_t tick;       // timestamp of the end of the frame
+} auart_rx_frame_t;
+
+/**
+ * @brief An index shared between the thread and the IRQ context.
+ */
+#if (CONFIG_AUART_USE_C11_ATOMICS == 1)
+typedef _Atomic auart_index_t auart_atomic_t;
+typedef _Atomic uint32_t auart_atomic32_t;
+#else
+typedef volatile auart_index_t auart_atomic_t;
+typedef volatile uint32_t auart_atomic32_t;
+#endif
+
 /**
  * @brief The AUART device structure
  * @warning User should not access the members of this structure directly.
  */
 typedef struct
 {
-    uint8_t tx_buffer[CONFIG_AUART_TX_BUFFER_SIZE];
-    uint8_t rx_buffer[CONFIG_AUART_RX_BUFFER_SIZE];
+#if (CONFIG_AUART_TX_BUFFER_SIZE > 0)
+    uint8_t tx_storage[CONFIG_AUART_TX_BUFFER_SIZE];
+#endif
+#if (CONFIG_AUART_RX_BUFFER_SIZE > 0)
+    uint8_t rx_storage[CONFIG_AUART_RX_BUFFER_SIZE];
+#endif
+
+    uint8_t *tx_buffer;
+    uint8_t *rx_buffer;
+    int32_t tx_size;
+    int32_t rx_size;
+
+    auart_atomic_t tx_head; // rw by DMA and IRQ, ro by api
+    auart_atomic_t tx_tail; // ro by DMA and IRQ, rw by api
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER == 1)
+    // end of the ranges claimed by the writers, `tx_tail` catches up with
+    // it once all of them are filled.
+    auart_atomic_t tx_claim; // rw by api
 
-    volatile uint32_t tx_head; // rw by DMA and IRQ, ro by api
-    volatile uint32_t tx_tail; // ro by DMA and IRQ, rw by api
+    // writers inside the TX buffer in the low byte, and the number of
+    // writers ever entered above it, see `__auart_tx_leave()`.
+    auart_atomic32_t tx_writers; // rw by api
+#endif
+
+    auart_atomic_t rx_head; // rw by api, moved by IRQ on an overrun
+    auart_atomic_t rx_tail; // rw by DMA and IRQ, ro by api
+
+    // overruns detected by IRQ, and the ones already reported by the api
+    auart_atomic32_t rx_overrun_count; // rw by IRQ, ro by api
+    uint32_t rx_overrun_reported;      // rw by api
 
-    volatile uint32_t rx_head;       // ro by DMA and IRQ, rw by api
-    volatile uint32_t rx_start;      // ro by DMA and IRQ, rw by api
-    volatile uint32_t rx_batch_size; // ro by DMA and IRQ, rw by api
-    volatile uint32_t rx_tail;       // rw by DMA and IRQ, ro by api
+    // the sender or the DMA is paused, see CONFIG_AUART_RX_OVERRUN_POLICY
+    auart_atomic_t rx_paused; // rw by IRQ and api
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+    auart_rx_frame_t rx_frames[CONFIG_AUART_RX_FRAME_QUEUE_SIZE];
+    auart_atomic_t rx_frame_head;          // ro by IRQ, rw by api
+    auart_atomic_t rx_frame_tail;          // rw by IRQ, ro by api
+    volatile auart_index_t rx_frame_start; // rw by the owner of the lock
+    auart_atomic_t rx_frame_lock;          // rw by IRQ
+#endif
 
     /**
-     * This union 'flags' is to make the flag operations atomic.
+     * The owner of the TX DMA.
      *
-     * if the value of such flag is 0, it means the DMA is not started.
-     * otherwise, it represents the number of bytes of last dma_start's
-     * `len` parameter.
+     * if the value is 0, the DMA is stopped and can be claimed by exactly
+     * one context with a compare-and-swap. the context that wins starts
+     * the DMA and marks it as started, from then on the DMA is owned by
+     * the transfer complete interrupt, which hands it back by clearing
+     * this flag.
      */
-    volatile union
-    {
-        int32_t is_started;
-        int32_t commited_size;
-    } tx_dma;
+    auart_atomic_t tx_dma_state;
+
+    // the number of bytes of last dma_start's `len` parameter.
+    auart_atomic_t tx_dma_size; // rw by the owner of the DMA
+
+    // number of bytes queued behind the running transfer, 0 if none.
+    volatile auart_index_t tx_dma_queued_size; // rw by the owner of the DMA
+
+#if (CONFIG_AUART_TX_COALESCE_HOLD_MS > 0)
+    // small writes are being held back, see CONFIG_AUART_TX_COALESCE_HOLD_MS
+    volatile bool tx_holding;      // rw by api, cleared by tick
+    volatile uint32_t tx_hold_tick; // rw by api, ro by tick
+#endif
 
-    auart_init_t op;
+#if (CONFIG_AUART_TICK_LATENCY_MS > 0)
+    // when `auart_tick()` last looked at the RX DMA
+    volatile uint32_t rx_tick_last; // rw by tick
+#endif
+
+    // the pending data is being moved by AUART_TX_OVERWRITE_OLDEST, no
+    // transfer may be started meanwhile.
+    volatile bool tx_rewriting; // rw by api
+
+#if (CONFIG_AUART_STATS == 1)
+    // writers inside in the low half, and the number of updates above it,
+    // see `auart_get_stats()`.
+    auart_atomic32_t stats_seq; // rw by IRQ and api
+    auart_atomic32_t stats[sizeof(auart_stats_t) / sizeof(uint32_t)];
+#endif
+
+    const auart_ops_t *op;
+    uint8_t dir;       // auart_dir_t
+    uint8_t tx_policy; // auart_tx_policy_t
+    uint32_t tx_timeout_ms;
+
+    void *h_rxdma;
+    void *h_txdma;
+    void *h_event;
+    void *h_deferred;
 } auart_t;
 
 /**
@@ -202,6 +590,36 @@ int auart_idle_callback(auart_t *hauart);
  */
 int auart_tx_cplt_callback(auart_t *hauart);
 
+/**
+ * @brief AUART deferred handler.
+ *
+ * User should call this function in the handler pended by
+ * `pend_deferred()`. It starts the TX DMA if there is pending data.
+ *
+ * @param hauart the AUART handle
+ * @return int <0: Error, =0: Success
+ *
+ * @note requires CONFIG_AUART_TX_DEFERRED_KICK, returns
+ * AUART_NOT_SUPPORTED otherwise.
+ */
+int auart_deferred_handler(auart_t *hauart);
+
+/**
+ * @brief AUART periodic tick.
+ *
+ * User should call this function from a periodic interrupt, like SysTick.
+ * It announces the bytes received since the last RX interrupt, so a link
+ * that never goes idle is seen within CONFIG_AUART_TICK_LATENCY_MS, and
+ * sends the TX data held back longer than CONFIG_AUART_TX_COALESCE_HOLD_MS.
+ * Nothing is done when no byte arrived.
+ *
+ * @note required for CONFIG_AUART_TX_COALESCE_HOLD_MS to bound the hold.
+ *
+ * @param hauart the AUART handle
+ * @return int <0: Error, =0: Success
+ */
+int auart_tick(auart_t *hauart);
+
 /**
  * @brief Initialize the AUART Driver
  *
@@ -218,9 +636,85 @@ int auart_init(auart_t *hauart, auart_init_t *init);
  * @param data to be sent
  * @param len how many bytes to be sent
  * @return int <0: Error, otherwise the number of bytes sent
+ *
+ * @note what happens when the TX buffer is full depends on the
+ * `tx_policy` of the port, see auart_tx_policy_t.
  */
 int auart_tx(auart_t *hauart, const void *data, int32_t len);
 
+/**
+ * @brief Send data to UART Port from an interrupt handler.
+ *
+ * Same as `auart_tx()`, it can preempt or be preempted by any other
+ * writer of the same port. It never waits, AUART_TX_BLOCK is treated as
+ * AUART_TX_PARTIAL.
+ *
+ * @param hauart the AUART handle
+ * @param data to be sent
+ * @param len how many bytes to be sent
+ * @return int <0: Error, otherwise the number of bytes sent
+ *
+ * @note requires CONFIG_AUART_TX_MULTI_PRODUCER, returns
+ * AUART_NOT_SUPPORTED otherwise.
+ */
+int auart_tx_from_isr(auart_t *hauart, const void *data, int32_t len);
+
+/**
+ * @brief Send a frame made of several segments to UART Port.
+ *
+ * All the segments are copied into the TX buffer back to back under a
+ * single capacity check, and the TX DMA is started at most once. The
+ * frame is either queued entirely or not at all.
+ *
+ * @param hauart the AUART handle
+ * @param iov the segments to be sent
+ * @param iovcnt how many segments in `iov`
+ * @return int <0: Error, =0: not enough space in the TX buffer,
+ * otherwise the number of bytes sent
+ *
+ * @note frames larger than the TX buffer are rejected with
+ * AUART_INVALID_ARGUMENT since they could never fit.
+ */
+int auart_txv(auart_t *hauart, const auart_iovec_t *iov, int32_t iovcnt);
+
+/**
+ * @brief Get writable space in the TX buffer without copying.
+ *
+ * The free region starting at the end of the pending data is returned as
+ * up to two spans pointing directly into the TX buffer. The caller fills
+ * them and publishes the bytes with `auart_tx_commit()`.
+ *
+ * @param hauart the AUART handle
+ * @param spans array of two spans to be filled
+ * @return int <0: Error, otherwise the number of bytes writable
+ *
+ * @note returns AUART_NOT_SUPPORTED with CONFIG_AUART_TX_MULTI_PRODUCER.
+ */
+int auart_tx_reserve(auart_t *hauart, auart_span_t spans[2]);
+
+/**
+ * @brief Publish bytes written into the spans of `auart_tx_reserve()`
+ * and start the TX DMA if it is idle.
+ *
+ * @param hauart the AUART handle
+ * @param len how many bytes to be published
+ * @return int <0: Error, otherwise the number of bytes published
+ *
+ * @note returns AUART_NOT_SUPPORTED with CONFIG_AUART_TX_MULTI_PRODUCER.
+ */
+int auart_tx_commit(auart_t *hauart, int32_t len);
+
+/**
+ * @brief Start sending the data held back by the TX coalescing window
+ * right away.
+ *
+ * @param hauart the AUART handle
+ * @return int <0: Error, =0: Success
+ *
+ * @note see CONFIG_AUART_TX_COALESCE_MIN_SIZE.
+ */
+int auart_tx_kick(auart_t *hauart);
+
 /**
  * @brief Read data from UART Port.
  *
@@ -228,15 +722,159 @@ int auart_tx(auart_t *hauart, const void *data, int32_t len);
  * @param data the buffer to store the received data
  * @param len how many bytes can be received
  * @return int <0: Error, otherwise the number of bytes received
+ *
+ * @note returns AUART_OVERRUN once when received bytes have been lost,
+ * the next call returns the data following the gap. See
+ * CONFIG_AUART_RX_OVERRUN_POLICY.
  */
 int auart_rx(auart_t *hauart, void *data, int32_t len);
 
+/**
+ * @brief Get the received data without copying it out of the RX buffer.
+ *
+ * The readable region is returned as up to two spans pointing directly
+ * into the RX buffer. The data stays valid until it is released by
+ * `auart_rx_consume()`.
+ *
+ * @param hauart the AUART handle
+ * @param spans array of two spans to be filled
+ * @return int <0: Error, otherwise the number of bytes readable
+ *
+ * @note returns AUART_OVERRUN once when received bytes have been lost.
+ */
+int auart_rx_peek(auart_t *hauart, auart_span_t spans[2]);
+
+/**
+ * @brief Release received data from the RX buffer.
+ *
+ * @param hauart the AUART handle
+ * @param len how many bytes to be released
+ * @return int <0: Error, otherwise the number of bytes released
+ *
+ * @note returns AUART_OVERRUN, and releases nothing, if the peeked data
+ * has been overwritten meanwhile.
+ */
+int auart_rx_consume(auart_t *hauart, int32_t len);
+
+/**
+ * @brief Find a delimiter in the received data.
+ *
+ * The RX buffer is searched across the wrap point, nothing is copied or
+ * released. Together with `auart_rx_peek()` and `auart_rx_consume()` this
+ * allows parsing lines in place.
+ *
+ * @param hauart the AUART handle
+ * @param delim the delimiter to search for, e.g. '\n'
+ * @return int <0: Error, =0: delimiter not received yet, otherwise the
+ * number of bytes up to and including the delimiter
+ */
+int auart_rx_find(auart_t *hauart, uint8_t delim);
+
+/**
+ * @brief Read data from UART Port up to and including a delimiter.
+ *
+ * Nothing is read until the delimiter is received, unless `len` bytes
+ * are already waiting, in which case the first `len` bytes are returned
+ * like `fgets()` does.
+ *
+ * @param hauart the AUART handle
+ * @param delim the delimiter to search for, e.g. '\n'
+ * @param data the buffer to store the received data
+ * @param len how many bytes can be received
+ * @return int <0: Error, =0: no complete line yet, otherwise the number
+ * of bytes received
+ */
+int auart_rx_until(auart_t *hauart, uint8_t delim, void *data, int32_t len);
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+/**
+ * @brief Read one received frame from UART Port.
+ *
+ * A frame is the burst of bytes received between two idle lines. The RX
+ * buffer is released up to the end of the frame, so this function should
+ * not be mixed with the other RX functions.
+ *
+ * @param hauart the AUART handle
+ * @param data the buffer to store the frame
+ * @param len how many bytes can be received, the rest of a longer frame
+ * is discarded
+ * @param out_tick the timestamp of the end of the frame, can be NULL
+ * @return int <0: Error, =0: no frame received, otherwise the number of
+ * bytes received
+ *
+ * @note returns AUART_OVERRUN once when received bytes have been lost,
+ * the frames queued at that point are dropped.
+ */
+int auart_rx_frame(auart_t *hauart, void *data, int32_t len,
+                   uint32_t *out_tick);
+#endif
+
+/**
+ * @brief Read the counters of a port.
+ *
+ * The counters are copied without masking the interrupts. The copy is
+ * retried if any of them changed meanwhile, so all the counters are from
+ * the same instant.
+ *
+ * @param hauart the AUART handle
+ * @param stats the structure to be filled
+ * @return int <0: Error, =0: Success, AUART_BUSY if the counters kept
+ * changing, e.g. when called from an interrupt that preempted an update.
+ *
+ * @note requires CONFIG_AUART_STATS, returns AUART_NOT_SUPPORTED
+ * otherwise.
+ */
+int auart_get_stats(auart_t *hauart, auart_stats_t *stats);
+
 /**
  * @brief Wait all the data in the TX buffer to be sent.
  *
+ * The data held back by the TX coalescing window is sent right away.
+ *
  * @param hauart the AUART handle
  * @return int <0: Error, =0: Success
  */
 int auart_tx_flush(auart_t *hauart);
 
+#if (CONFIG_AUART_USE_TIME_API == 1)
+/**
+ * @brief Wait all the data in the TX buffer to be sent, with a timeout.
+ *
+ * @param hauart the AUART handle
+ * @param timeout_ms the maximum time to wait, or AUART_WAIT_FOREVER
+ * @return int <0: Error, AUART_TIMEOUT if the data is not sent in time,
+ * =0: Success
+ */
+int auart_tx_flush_timeout(auart_t *hauart, uint32_t timeout_ms);
+
+/**
+ * @brief Send data to UART Port, waiting for space in the TX buffer.
+ *
+ * @param hauart the AUART handle
+ * @param data to be sent
+ * @param len how many bytes to be sent
+ * @param timeout_ms the maximum time to wait, or AUART_WAIT_FOREVER
+ * @return int <0: Error, otherwise the number of bytes sent, which is
+ * less than `len` only if the timeout expired
+ */
+int auart_tx_timeout(auart_t *hauart, const void *data, int32_t len,
+                     uint32_t timeout_ms);
+
+/**
+ * @brief Read data from UART Port, waiting for data to arrive.
+ *
+ * Returns as soon as at least one byte is received, like `read()` of
+ * POSIX.
+ *
+ * @param hauart the AUART handle
+ * @param data the buffer to store the received data
+ * @param len how many bytes can be received
+ * @param timeout_ms the maximum time to wait, or AUART_WAIT_FOREVER
+ * @return int <0: Error, otherwise the number of bytes received, which is
+ * 0 only if the timeout expired
+ */
+int auart_rx_timeout(auart_t *hauart, void *data, int32_t len,
+                     uint32_t timeout_ms);
+#endif
+
 #endif // !#ifndef __AUART_H__
@@ -0,0 +1,164 @@
+/**
+ * @file bench_coalesce.c
+ * @brief TX complete interrupts per KB with and without write coalescing
+ *
+ * Small writes arrive a few per millisecond on a fast line. Without
+ * coalescing (`auart_tx_kick()` after every write) each write costs a
+ * transfer and a complete interrupt. With CONFIG_AUART_TX_COALESCE_MIN_SIZE
+ * they are batched, and `auart_tick()` every millisecond keeps each byte
+ * held back no longer than CONFIG_AUART_TX_COALESCE_HOLD_MS plus a tick.
+ * Without the tick the hold has no bound.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+
+#if (CONFIG_AUART_TX_COALESCE_MIN_SIZE == 0) || \
+    (CONFIG_AUART_TX_COALESCE_HOLD_MS == 0)
+#error "build with CONFIG_AUART_TX_COALESCE_MIN_SIZE and _HOLD_MS set"
+#endif
+
+#define BENCH_BYTES 1000000L
+
+typedef enum
+{
+    MODE_KICK_EVERY_WRITE,
+    MODE_COALESCE,
+    MODE_COALESCE_NO_TICK,
+} coalesce_mode_t;
+
+static auart_t auart;
+static uint8_t tx_buffer[1024];
+
+// the millisecond each byte was written at
+static uint32_t write_ms[BENCH_BYTES + 1024];
+
+typedef struct
+{
+    long irqs;
+    uint32_t max_hold_ms;
+} coalesce_result_t;
+
+static void drain(coalesce_result_t *result, long *sent)
+{
+    uint8_t line[sizeof(tx_buffer)];
+    int32_t n;
+    while ((n = sim_tx_complete(line)) > 0)
+    {
+        result->irqs++;
+
+        for (int32_t i = 0; i < n; i++, (*sent)++)
+        {
+            CHECK(line[i] == (uint8_t)*sent);
+
+            uint32_t hold_ms = sim.tick_ms - write_ms[*sent];
+            if (hold_ms > result->max_hold_ms)
+                result->max_hold_ms = hold_ms;
+        }
+    }
+}
+
+static coalesce_result_t run(coalesce_mode_t mode)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = sizeof(tx_buffer),
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    coalesce_result_t result = {0, 0};
+    long written = 0;
+    long sent = 0;
+    bool is_tail_written = false;
+
+    srand(3);
+
+    while (!is_tail_written || sent < written)
+    {
+        sim.tick_ms++;
+
+        // the last byte is written alone after a flush, so it is only
+        // released by the hold
+        if (written >= BENCH_BYTES && !is_tail_written)
+        {
+            CHECK(auart_tx_kick(&auart) == AUART_OK);
+            drain(&result, &sent);
+
+            uint8_t tail = (uint8_t)written;
+            write_ms[written] = sim.tick_ms;
+            CHECK(auart_tx(&auart, &tail, 1) == 1);
+            written++;
+            is_tail_written = true;
+
+            if (mode == MODE_KICK_EVERY_WRITE)
+                CHECK(auart_tx_kick(&auart) == AUART_OK);
+        }
+
+        // up to 3 writes of 1 to 16 bytes
+        int writes = written < BENCH_BYTES ? rand() % 4 : 0;
+        while (writes-- > 0)
+        {
+            uint8_t data[16];
+            int32_t len = rand() % sizeof(data) + 1;
+            for (int32_t i = 0; i < len; i++)
+            {
+                data[i] = (uint8_t)(written + i);
+                write_ms[written + i] = sim.tick_ms;
+            }
+
+            CHECK(auart_tx(&auart, data, len) == len);
+            written += len;
+
+            if (mode == MODE_KICK_EVERY_WRITE)
+                CHECK(auart_tx_kick(&auart) == AUART_OK);
+        }
+
+        if (mode != MODE_COALESCE_NO_TICK)
+            CHECK(auart_tick(&auart) == AUART_OK);
+
+        drain(&result, &sent);
+
+        // nothing else ever releases the last byte
+        if (mode == MODE_COALESCE_NO_TICK && is_tail_written &&
+            sim.tick_ms - write_ms[written - 1] > 1000)
+        {
+            result.max_hold_ms = UINT32_MAX;
+            break;
+        }
+    }
+
+    return result;
+}
+
+static void report(const char *name, coalesce_result_t result)
+{
+    if (result.max_hold_ms == UINT32_MAX)
+        printf("bench_coalesce: %-22s %6.1f irqs/KB, max hold unbounded\n",
+               name, result.irqs * 1024.0 / BENCH_BYTES);
+    else
+        printf("bench_coalesce: %-22s %6.1f irqs/KB, max hold %u ms\n",
+               name, result.irqs * 1024.0 / BENCH_BYTES,
+               (unsigned)result.max_hold_ms);
+}
+
+int main(void)
+{
+    coalesce_result_t off = run(MODE_KICK_EVERY_WRITE);
+    coalesce_result_t on = run(MODE_COALESCE);
+    coalesce_result_t no_tick = run(MODE_COALESCE_NO_TICK);
+
+    report("kick every write", off);
+    report("coalesce + auart_tick", on);
+    report("coalesce, no tick", no_tick);
+
+    CHECK(on.irqs * 2 < off.irqs);
+    CHECK(on.max_hold_ms <= CONFIG_AUART_TX_COALESCE_HOLD_MS + 1);
+    CHECK(no_tick.max_hold_ms == UINT32_MAX);
+
+    return 0;
+}
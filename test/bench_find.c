@@ -0,0 +1,102 @@
+/**
+ * @file bench_find.c
+ * @brief `auart_rx_find()` against a byte by byte search on a 1 KB ring
+ *
+ * The ring is kept almost full, with the delimiter at random places and
+ * the data starting at every alignment and wrap point. Both searches must
+ * agree, the time per KB searched is reported.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+#include <time.h>
+
+#define BENCH_RX_SIZE 1024
+#define BENCH_ROUNDS 2000
+#define BENCH_SEARCHES 50
+
+static auart_t auart;
+static uint8_t rx_buffer[BENCH_RX_SIZE];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int naive_find(uint8_t delim)
+{
+    auart_span_t spans[2];
+    int res = auart_rx_peek(&auart, spans);
+    if (res <= 0)
+        return res;
+
+    int32_t off = 0;
+    for (int s = 0; s < 2; s++)
+    {
+        for (int32_t i = 0; i < spans[s].len; i++)
+        {
+            if (spans[s].data[i] == delim)
+                return off + i + 1;
+        }
+        off += spans[s].len;
+    }
+
+    return 0;
+}
+
+int main(void)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_RX_ONLY,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = BENCH_RX_SIZE,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    double swar_ns = 0;
+    double naive_ns = 0;
+    double searched = 0;
+
+    srand(4);
+
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        // an almost full ring starting wherever the last round ended, the
+        // delimiter is missing in a quarter of the rounds
+        int32_t fill = BENCH_RX_SIZE - 1 - rand() % 61;
+        int32_t delim_pos = rand() % 4 ? rand() % fill : -1;
+
+        for (int32_t i = 0; i < fill; i++)
+            sim_rx_byte(i == delim_pos ? '\n' : 'a' + i % 26, false);
+        sim_rx_idle();
+
+        int expected = delim_pos + 1;
+
+        double start = now_ns();
+        for (int i = 0; i < BENCH_SEARCHES; i++)
+            CHECK(auart_rx_find(&auart, '\n') == expected);
+        swar_ns += now_ns() - start;
+
+        start = now_ns();
+        for (int i = 0; i < BENCH_SEARCHES; i++)
+            CHECK(naive_find('\n') == expected);
+        naive_ns += now_ns() - start;
+
+        searched += (double)BENCH_SEARCHES * (delim_pos < 0 ? fill : expected);
+
+        CHECK(auart_rx_consume(&auart, fill) == fill);
+    }
+
+    printf("bench_find: byte by byte   %6.1f ns/KB\n",
+           naive_ns * 1024 / searched);
+    printf("bench_find: auart_rx_find  %6.1f ns/KB\n",
+           swar_ns * 1024 / searched);
+
+    return 0;
+}
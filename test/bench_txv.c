@@ -0,0 +1,104 @@
+/**
+ * @file bench_txv.c
+ * @brief `auart_txv()` against three back-to-back `auart_tx()` calls
+ *
+ * Sends a header, a payload and a CRC per frame, with the simulated DMA
+ * finishing every transfer right after the frame is queued. Reports the
+ * CPU time and the DMA starts per frame, and checks that the frames come
+ * out whole and in order.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FRAMES 200000
+
+static auart_t auart;
+static uint8_t tx_buffer[512];
+static uint8_t line[512];
+
+static const uint8_t header[4] = {0xAA, 0x55, 0x20, 0x00};
+static uint8_t payload[32];
+static const uint8_t crc[2] = {0x12, 0x34};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void check_line(int32_t len)
+{
+    int32_t frame_len = sizeof(header) + sizeof(payload) + sizeof(crc);
+    CHECK(len % frame_len == 0);
+
+    for (int32_t off = 0; off < len; off += frame_len)
+    {
+        CHECK(memcmp(line + off, header, sizeof(header)) == 0);
+        CHECK(memcmp(line + off + sizeof(header), payload,
+                     sizeof(payload)) == 0);
+        CHECK(memcmp(line + off + sizeof(header) + sizeof(payload), crc,
+                     sizeof(crc)) == 0);
+    }
+}
+
+static void bench(const char *name, bool use_txv)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = sizeof(tx_buffer),
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    const auart_iovec_t iov[3] = {
+        {header, sizeof(header)},
+        {payload, sizeof(payload)},
+        {crc, sizeof(crc)},
+    };
+
+    double start = now_ns();
+
+    for (int i = 0; i < BENCH_FRAMES; i++)
+    {
+        if (use_txv)
+        {
+            CHECK(auart_txv(&auart, iov, 3) == 38);
+        }
+        else
+        {
+            CHECK(auart_tx(&auart, header, sizeof(header)) == 4);
+            CHECK(auart_tx(&auart, payload, sizeof(payload)) == 32);
+            CHECK(auart_tx(&auart, crc, sizeof(crc)) == 2);
+        }
+
+        int32_t len = 0;
+        int32_t res;
+        while ((res = sim_tx_complete(line + len)) > 0)
+            len += res;
+
+        check_line(len);
+    }
+
+    double elapsed = now_ns() - start;
+
+    printf("bench_txv: %-12s %6.1f ns/frame, %.2f dma starts/frame\n",
+           name, elapsed / BENCH_FRAMES, (double)sim.tx_starts / BENCH_FRAMES);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(payload); i++)
+        payload[i] = (uint8_t)i;
+
+    bench("3x auart_tx", false);
+    bench("auart_txv", true);
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+/**
+ * @file stm32f4xx_hal.h
+ * @brief Register-level mock of the STM32F4 HAL, for the F407 example port
+ *
+ * Just enough of the HAL for `example/STM32F407/Core/Src/usart.c` to build
+ * on the host. The DMA stream and the USART are plain register blocks the
+ * test plays the hardware on. The HAL calls that program a stream do it
+ * like the real ones, the others only report success.
+ *
+ * Addresses are written to the 32-bit address registers truncated, the
+ * test maps them back onto its buffers.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __STM32F4XX_HAL_H
+#define __STM32F4XX_HAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum
+{
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U,
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    USART1_IRQn = 37,
+} IRQn_Type;
+
+#define SET_BIT(REG, BIT) ((REG) |= (BIT))
+#define CLEAR_BIT(REG, BIT) ((REG) &= ~(BIT))
+
+/* registers -----------------------------------------------------------------*/
+
+typedef struct
+{
+    volatile uint32_t CR;
+    volatile uint32_t NDTR;
+    volatile uint32_t PAR;
+    volatile uint32_t M0AR;
+    volatile uint32_t M1AR;
+    volatile uint32_t FCR;
+
+    // mock only: the bits of this stream in LISR / HISR, and the value
+    // NDTR reloads with at the end of a transfer.
+    volatile uint32_t ISR;
+    volatile uint32_t NDTR_RELOAD;
+} DMA_Stream_TypeDef;
+
+#define DMA_SxCR_EN (1U << 0)
+#define DMA_SxCR_TCIE (1U << 4)
+#define DMA_SxCR_CIRC (1U << 8)
+#define DMA_SxCR_DBM (1U << 18)
+#define DMA_SxCR_CT (1U << 19)
+
+typedef struct
+{
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+    volatile uint32_t BRR;
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t CR3;
+    volatile uint32_t GTPR;
+} USART_TypeDef;
+
+#define USART_SR_ORE (1U << 3)
+#define USART_SR_IDLE (1U << 4)
+#define USART_SR_RXNE (1U << 5)
+#define USART_CR1_IDLEIE (1U << 4)
+#define USART_CR3_DMAR (1U << 6)
+#define USART_CR3_DMAT (1U << 7)
+
+typedef struct
+{
+    uint32_t MODER;
+} GPIO_TypeDef;
+
+// defined by the test
+extern USART_TypeDef mock_usart1;
+extern DMA_Stream_TypeDef mock_dma2_stream2;
+extern DMA_Stream_TypeDef mock_dma2_stream7;
+extern GPIO_TypeDef mock_gpioa;
+
+#define USART1 (&mock_usart1)
+#define DMA2_Stream2 (&mock_dma2_stream2)
+#define DMA2_Stream7 (&mock_dma2_stream7)
+#define GPIOA (&mock_gpioa)
+
+/* gpio ----------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+#define GPIO_PIN_9 (1U << 9)
+#define GPIO_PIN_10 (1U << 10)
+#define GPIO_MODE_AF_PP 0x02U
+#define GPIO_NOPULL 0x00U
+#define GPIO_SPEED_FREQ_VERY_HIGH 0x03U
+#define GPIO_AF7_USART1 0x07U
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_USART1_CLK_ENABLE() ((void)0)
+#define __HAL_RCC_USART1_CLK_DISABLE() ((void)0)
+
+static inline void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+static inline void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+    (void)GPIOx;
+    (void)GPIO_Pin;
+}
+
+static inline void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority,
+                                        uint32_t SubPriority)
+{
+    (void)IRQn;
+    (void)PreemptPriority;
+    (void)SubPriority;
+}
+
+static inline void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+}
+
+static inline void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    (void)IRQn;
+}
+
+/* dma -----------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+    uint32_t FIFOMode;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+    DMA_Stream_TypeDef *Instance;
+    DMA_InitTypeDef Init;
+    void *Parent;
+    void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferM1CpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferM1HalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferAbortCallback)(struct __DMA_HandleTypeDef *hdma);
+} DMA_HandleTypeDef;
+
+#define DMA_CHANNEL_4 (4U << 25)
+#define DMA_PERIPH_TO_MEMORY 0x00U
+#define DMA_MEMORY_TO_PERIPH (1U << 6)
+#define DMA_PINC_DISABLE 0x00U
+#define DMA_MINC_ENABLE (1U << 10)
+#define DMA_PDATAALIGN_BYTE 0x00U
+#define DMA_MDATAALIGN_BYTE 0x00U
+#define DMA_NORMAL 0x00U
+#define DMA_CIRCULAR DMA_SxCR_CIRC
+#define DMA_PRIORITY_LOW 0x00U
+#define DMA_FIFOMODE_DISABLE 0x00U
+
+// the flags of a stream, in the mock `ISR` register
+#define DMA_FLAG_HTIF (1U << 4)
+#define DMA_FLAG_TCIF (1U << 5)
+
+#define __HAL_DMA_GET_TC_FLAG_INDEX(__HANDLE__) DMA_FLAG_TCIF
+#define __HAL_DMA_GET_HT_FLAG_INDEX(__HANDLE__) DMA_FLAG_HTIF
+#define __HAL_DMA_GET_FLAG(__HANDLE__, __FLAG__) \
+    (((__HANDLE__)->Instance->ISR & (__FLAG__)) != 0U)
+#define __HAL_DMA_CLEAR_FLAG(__HANDLE__, __FLAG__) \
+    ((__HANDLE__)->Instance->ISR &= ~(__FLAG__))
+#define __HAL_DMA_ENABLE(__HANDLE__) \
+    ((__HANDLE__)->Instance->CR |= DMA_SxCR_EN)
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do                                                              \
+    {                                                               \
+        (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);        \
+        (__DMA_HANDLE__).Parent = (__HANDLE__);                     \
+    } while (0)
+
+static inline HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    (void)hdma;
+    return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+    (void)hdma;
+    return HAL_OK;
+}
+
+// like the HAL, the stream is disabled and its flags cleared, CT is left
+// as it is.
+static inline HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    hdma->Instance->CR &= ~(DMA_SxCR_EN | DMA_SxCR_TCIE);
+    hdma->Instance->ISR = 0;
+    return HAL_OK;
+}
+
+// like the HAL, CT is not touched, the stream starts on the target it was
+// left on.
+static inline HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(
+    DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress,
+    uint32_t SecondMemAddress, uint32_t DataLength)
+{
+    if (hdma->XferCpltCallback == NULL || hdma->XferM1CpltCallback == NULL ||
+        hdma->XferErrorCallback == NULL || (hdma->Instance->CR & DMA_SxCR_EN))
+        return HAL_ERROR;
+
+    hdma->Instance->CR |= DMA_SxCR_DBM;
+    hdma->Instance->M1AR = SecondMemAddress;
+    hdma->Instance->NDTR = DataLength;
+    hdma->Instance->NDTR_RELOAD = DataLength;
+    hdma->Instance->PAR = SrcAddress;
+    hdma->Instance->M0AR = DstAddress;
+    hdma->Instance->ISR = 0;
+    hdma->Instance->CR |= DMA_SxCR_TCIE | DMA_SxCR_EN;
+    return HAL_OK;
+}
+
+/* uart ----------------------------------------------------------------------*/
+
+typedef struct
+{
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct __UART_HandleTypeDef
+{
+    USART_TypeDef *Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B 0x00U
+#define UART_STOPBITS_1 0x00U
+#define UART_PARITY_NONE 0x00U
+#define UART_MODE_TX_RX 0x0CU
+#define UART_HWCONTROL_NONE 0x00U
+#define UART_OVERSAMPLING_16 0x00U
+
+#define UART_FLAG_ORE USART_SR_ORE
+#define UART_FLAG_RXNE USART_SR_RXNE
+#define UART_IT_IDLE USART_CR1_IDLEIE
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__) \
+    (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__) \
+    ((__HANDLE__)->Instance->CR1 |= (__INTERRUPT__))
+
+// the hardware clears both flags on the SR then DR read, the mock has no
+// read side effects and clears them here.
+#define __HAL_UART_CLEAR_OREFLAG(__HANDLE__)                        \
+    do                                                              \
+    {                                                               \
+        (void)(__HANDLE__)->Instance->SR;                           \
+        (void)(__HANDLE__)->Instance->DR;                           \
+        (__HANDLE__)->Instance->SR &= ~(USART_SR_ORE | USART_SR_RXNE); \
+    } while (0)
+
+static inline HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef *huart,
+                                                     uint8_t *pData,
+                                                     uint16_t Size)
+{
+    (void)huart;
+    (void)pData;
+    (void)Size;
+    return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart,
+                                                      const uint8_t *pData,
+                                                      uint16_t Size)
+{
+    (void)huart;
+    (void)pData;
+    (void)Size;
+    return HAL_OK;
+}
+
+static inline HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    return HAL_OK;
+}
+
+// in the application
+void HAL_UART_MspInit(UART_HandleTypeDef *huart);
+void HAL_UART_MspDeInit(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+
+#endif // !#ifndef __STM32F4XX_HAL_H
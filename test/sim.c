@@ -0,0 +1,306 @@
+/**
+ * @file sim.c
+ * @brief Host simulator of the DMA channels behind `auart_ops_t`
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+// REG_EFL
+#define _GNU_SOURCE
+
+#include "sim.h"
+
+#include <string.h>
+
+#if (SIM_STEP == 1)
+#include <signal.h>
+#include <ucontext.h>
+
+#define TRAP_FLAG 0x100
+#endif
+
+sim_t sim;
+
+static int sim_rx_update_progress(void *hdma, uint32_t *out_bytes_left)
+{
+    (void)hdma;
+    *out_bytes_left = sim.rx_left;
+    return 0;
+}
+
+static int sim_rx_start(void *hdma, void *pdst, uint32_t len)
+{
+    (void)hdma;
+    sim.rx_dst = pdst;
+    sim.rx_len = len;
+    sim.rx_left = len;
+    sim.rx_running = true;
+    sim.rx_starts++;
+    return 0;
+}
+
+static int sim_rx_abort(void *hdma)
+{
+    (void)hdma;
+    sim.rx_running = false;
+    sim.rx_aborts++;
+    return 0;
+}
+
+static int sim_rx_lost(void *hdma)
+{
+    (void)hdma;
+    int is_lost = sim.rx_dropped != 0;
+    sim.rx_dropped = 0;
+    return is_lost;
+}
+
+static int sim_rx_flow(void *hdma, bool is_paused)
+{
+    (void)hdma;
+    sim.rx_flow_paused = is_paused;
+    if (is_paused)
+        sim.rx_flow_pauses++;
+    else
+        sim.rx_flow_resumes++;
+    return 0;
+}
+
+static int sim_tx_start(void *hdma, const void *psrc, uint32_t len)
+{
+    (void)hdma;
+    CHECK(!sim.tx_busy);
+    CHECK(len > 0);
+#if (CONFIG_AUART_TX_DEFERRED_KICK == 1)
+    CHECK(sim.is_in_deferred);
+#endif
+
+    sim.tx_src = psrc;
+    sim.tx_len = len;
+    sim.tx_busy = true;
+    sim.tx_starts++;
+    return 0;
+}
+
+static int sim_tx_queue(void *hdma, const void *psrc, uint32_t len)
+{
+    (void)hdma;
+    CHECK(sim.tx_queued_len == 0);
+    CHECK(len > 0);
+
+    sim.tx_queued_src = psrc;
+    sim.tx_queued_len = len;
+    sim.tx_queues++;
+    return 0;
+}
+
+static int sim_tx_abort(void *hdma)
+{
+    (void)hdma;
+    sim.tx_busy = false;
+    sim.tx_queued_len = 0;
+    return 0;
+}
+
+#if (CONFIG_AUART_USE_TIME_API == 1)
+static uint32_t sim_get_tick_ms(void)
+{
+    return sim.tick_ms;
+}
+#endif
+
+static void sim_notify_event(void *h_event)
+{
+    (void)h_event;
+    sim.notifies++;
+}
+
+static void sim_pend_deferred(void *h_deferred)
+{
+    (void)h_deferred;
+    sim.deferred_pending = true;
+    sim.deferred_pends++;
+}
+
+const auart_ops_t sim_ops = {
+    .dma_rx_update_progress = sim_rx_update_progress,
+    .dma_rx_start = sim_rx_start,
+    .dma_rx_abort = sim_rx_abort,
+    .rx_lost = sim_rx_lost,
+    .rx_flow = sim_rx_flow,
+    .dma_tx_start = sim_tx_start,
+    .dma_tx_abort = sim_tx_abort,
+#if (CONFIG_AUART_USE_TIME_API == 1)
+    .get_tick_ms = sim_get_tick_ms,
+#endif
+    .notify_event = sim_notify_event,
+    .pend_deferred = sim_pend_deferred,
+};
+
+const auart_ops_t sim_ops_queue = {
+    .dma_rx_update_progress = sim_rx_update_progress,
+    .dma_rx_start = sim_rx_start,
+    .dma_rx_abort = sim_rx_abort,
+    .rx_lost = sim_rx_lost,
+    .rx_flow = sim_rx_flow,
+    .dma_tx_start = sim_tx_start,
+    .dma_tx_abort = sim_tx_abort,
+    .dma_tx_queue = sim_tx_queue,
+#if (CONFIG_AUART_USE_TIME_API == 1)
+    .get_tick_ms = sim_get_tick_ms,
+#endif
+    .notify_event = sim_notify_event,
+    .pend_deferred = sim_pend_deferred,
+};
+
+int sim_init(auart_t *hauart, auart_init_t *init)
+{
+    auart_init_t default_init = {0};
+    if (init == NULL)
+        init = &default_init;
+
+    if (init->ops == NULL)
+        init->ops = &sim_ops;
+    if (init->h_rxdma == NULL)
+        init->h_rxdma = &sim;
+    if (init->h_txdma == NULL)
+        init->h_txdma = &sim;
+    if (init->h_deferred == NULL)
+        init->h_deferred = &sim;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.hauart = hauart;
+
+    return auart_init(hauart, init);
+}
+
+void sim_rx_byte(uint8_t c, bool with_irq)
+{
+    if (!sim.rx_running)
+    {
+        sim.rx_dropped++;
+        return;
+    }
+
+    sim.rx_dst[sim.rx_len - sim.rx_left] = c;
+    sim.rx_left--;
+    sim.rx_bytes++;
+
+    if (sim.rx_left == sim.rx_len / 2 && with_irq)
+    {
+        sim.rx_halfs++;
+        auart_dma_rx_half_cplt_callback(sim.hauart);
+    }
+
+    if (sim.rx_left == 0)
+    {
+        // circular mode, the counter reloads right away
+        sim.rx_left = sim.rx_len;
+        if (with_irq)
+        {
+            sim.rx_cplts++;
+            auart_dma_rx_cplt_callback(sim.hauart);
+        }
+    }
+}
+
+void sim_rx_idle(void)
+{
+    sim.idles++;
+    auart_idle_callback(sim.hauart);
+}
+
+int32_t sim_tx_complete(uint8_t *out)
+{
+    if (!sim.tx_busy)
+        return 0;
+
+    int32_t len = sim.tx_len;
+    if (out != NULL)
+        memcpy(out, sim.tx_src, len);
+    sim.tx_bytes += len;
+
+    if (sim.tx_queued_len)
+    {
+        sim.tx_src = sim.tx_queued_src;
+        sim.tx_len = sim.tx_queued_len;
+        sim.tx_queued_len = 0;
+    }
+    else
+    {
+        sim.tx_busy = false;
+    }
+
+    // the complete interrupt may preempt the deferred handler
+    bool is_in_deferred = sim.is_in_deferred;
+    sim.is_in_deferred = false;
+    auart_tx_cplt_callback(sim.hauart);
+    sim.is_in_deferred = is_in_deferred;
+
+    return len;
+}
+
+bool sim_run_deferred(void)
+{
+    if (!sim.deferred_pending)
+        return false;
+
+    sim.deferred_pending = false;
+    sim.deferred_runs++;
+
+    sim.is_in_deferred = true;
+    CHECK(auart_deferred_handler(sim.hauart) >= 0);
+    sim.is_in_deferred = false;
+
+    return true;
+}
+
+#if (SIM_STEP == 1)
+static void (*volatile step_fn)(void);
+
+static void on_trap(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)info;
+
+    void (*fn)(void) = step_fn;
+    if (fn == NULL)
+    {
+        // done, the flag is restored cleared on return
+        ucontext_t *uc = context;
+        uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+        return;
+    }
+
+    fn();
+}
+
+void sim_step_begin(void (*on_step)(void))
+{
+    static bool is_installed;
+    if (!is_installed)
+    {
+        struct sigaction sa = {0};
+        sa.sa_sigaction = on_trap;
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        CHECK(sigaction(SIGTRAP, &sa, NULL) == 0);
+        is_installed = true;
+    }
+
+    step_fn = on_step;
+    __asm__ volatile("pushfq\n\t"
+                     "orq $0x100, (%%rsp)\n\t"
+                     "popfq"
+                     :
+                     :
+                     : "memory", "cc");
+}
+
+void sim_step_end(void)
+{
+    // the next trap clears the flag
+    step_fn = NULL;
+}
+#endif
@@ -0,0 +1,139 @@
+/**
+ * @file sim.h
+ * @brief Host simulator of the DMA channels behind `auart_ops_t`
+ *
+ * A single simulated port: the RX DMA writes into the ring in circular
+ * mode and fires the half and complete callbacks like the hardware, the
+ * TX DMA holds one running transfer, and one queued transfer when the
+ * port is set up with `sim_ops_queue`.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __AUART_SIM_H__
+#define __AUART_SIM_H__
+
+#include "auart.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(cond)                                          \
+    do                                                       \
+    {                                                        \
+        if (!(cond))                                         \
+        {                                                    \
+            printf("%s:%d: check failed: %s\n",              \
+                   __FILE__, __LINE__, #cond);               \
+            exit(1);                                         \
+        }                                                    \
+    } while (0)
+
+typedef struct
+{
+    auart_t *hauart;
+
+    // rx, a circular transfer of `rx_len` bytes
+    uint8_t *rx_dst;
+    uint32_t rx_len;
+    volatile uint32_t rx_left;
+    volatile bool rx_running;
+    volatile long rx_dropped; // received while stopped, cleared by `rx_lost()`
+    volatile bool rx_flow_paused; // the sender is told to stop, `rx_flow()`
+
+    // tx, the running transfer and the one queued behind it
+    const uint8_t *volatile tx_src;
+    volatile uint32_t tx_len;
+    volatile bool tx_busy;
+    const uint8_t *volatile tx_queued_src;
+    volatile uint32_t tx_queued_len;
+
+    volatile uint32_t tick_ms;
+
+    // the deferred handler, pended by `pend_deferred()`
+    volatile bool deferred_pending;
+    volatile bool is_in_deferred;
+
+    // what the driver asked for
+    volatile long rx_starts;
+    volatile long rx_aborts;
+    volatile long rx_flow_pauses;
+    volatile long rx_flow_resumes;
+    volatile long tx_starts;
+    volatile long tx_queues;
+    volatile long notifies;
+    volatile long deferred_pends;
+    volatile long deferred_runs;
+
+    // what happened on the line
+    volatile long rx_bytes; // written into the ring
+    volatile long tx_bytes;
+    volatile long rx_halfs;
+    volatile long rx_cplts;
+    volatile long idles;
+} sim_t;
+
+extern sim_t sim;
+
+// without `dma_tx_queue()`, and with it
+extern const auart_ops_t sim_ops;
+extern const auart_ops_t sim_ops_queue;
+
+/**
+ * @brief Reset the simulator and initialize `hauart` on it.
+ *
+ * `init` may be NULL, the ops and the DMA handles are filled in when they
+ * are left zeroed.
+ */
+int sim_init(auart_t *hauart, auart_init_t *init);
+
+// the RX DMA writes one byte, the half and complete callbacks fire as the
+// counter crosses them when `with_irq` is set. the byte is dropped if the
+// DMA is stopped.
+void sim_rx_byte(uint8_t c, bool with_irq);
+
+// the line goes idle
+void sim_rx_idle(void);
+
+/**
+ * @brief Finish the running TX transfer.
+ *
+ * The bytes are appended to `out` if not NULL, the queued transfer takes
+ * over, then `auart_tx_cplt_callback()` is called.
+ *
+ * @return the number of bytes sent, 0 if the DMA was idle
+ */
+int32_t sim_tx_complete(uint8_t *out);
+
+/**
+ * @brief Run `auart_deferred_handler()` if `pend_deferred()` was called.
+ *
+ * The pending flag is cleared first, a request made while the handler
+ * runs pends it again. With CONFIG_AUART_TX_DEFERRED_KICK the TX DMA may
+ * only be started from here, the simulator checks that.
+ *
+ * @return whether the handler ran
+ */
+bool sim_run_deferred(void);
+
+#if defined(__x86_64__) && defined(__linux__)
+#define SIM_STEP 1
+#else
+#define SIM_STEP 0
+#endif
+
+#if (SIM_STEP == 1)
+/**
+ * @brief Call `on_step()` after every instruction of the calling thread,
+ * until `sim_step_end()`.
+ *
+ * Single steps with the x86 trap flag, `on_step()` runs in a signal
+ * handler like an interrupt between two instructions.
+ */
+void sim_step_begin(void (*on_step)(void));
+
+void sim_step_end(void);
+#endif
+
+#endif // !#ifndef __AUART_SIM_H__
@@ -0,0 +1,204 @@
+/**
+ * @file test_claim.c
+ * @brief The TX DMA claim, with the complete interrupt at every instruction
+ *
+ * `auart_tx()` is single stepped with the x86 trap flag and the simulated
+ * DMA completes its transfer, calling `auart_tx_cplt_callback()`, between
+ * two of its instructions. Every instruction boundary is tried, with the
+ * DMA completing once there, and with it completing again at each of the
+ * following boundaries like a DMA that is done right away.
+ *
+ * The DMA must never be started twice, the simulator checks that, and
+ * once `auart_tx()` returns the data left in the buffer must be owned by
+ * a running transfer, never stranded until the next write. The bytes
+ * must then come out exactly as they were written.
+ *
+ * The stepping needs x86-64 Linux, the test is skipped on other hosts.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#if (SIM_STEP == 1)
+
+#include <string.h>
+
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 64
+#endif
+
+typedef enum
+{
+    FIRE_ONCE,
+    FIRE_FROM,
+} fire_mode_t;
+
+typedef struct
+{
+    const char *name;
+    const auart_ops_t *ops;
+    int32_t skip;     // sent beforehand, moves the head along the buffer
+    int32_t busy_len; // written beforehand and left running in the dma
+    int32_t len;      // written by the stepped call
+} scenario_t;
+
+static auart_t auart;
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+static uint8_t line[TEST_TX_SIZE * 4];
+static volatile int32_t num_sent;
+
+static volatile long step;
+static long fire_step;
+static fire_mode_t fire_mode;
+static volatile long fired;
+
+static void on_step(void)
+{
+    step++;
+    if (step == fire_step || (fire_mode == FIRE_FROM && step > fire_step))
+    {
+        int32_t len = sim_tx_complete(line + num_sent);
+        if (len > 0)
+            fired++;
+        num_sent += len;
+    }
+}
+
+static int32_t write_seq(uint8_t *seq, int32_t len, bool is_stepped)
+{
+    uint8_t data[TEST_TX_SIZE];
+    for (int32_t i = 0; i < len; i++)
+        data[i] = (uint8_t)(*seq + i);
+
+    if (is_stepped)
+        sim_step_begin(on_step);
+
+    int res = auart_tx(&auart, data, len);
+
+    if (is_stepped)
+        sim_step_end();
+
+    CHECK(res >= 0 && res <= len);
+    *seq += res;
+    return res;
+}
+
+static void drain(void)
+{
+    while (sim.tx_busy)
+        num_sent += sim_tx_complete(line + num_sent);
+}
+
+// returns false once `fire_step` is past the end of the stepped call
+static bool run(const scenario_t *s, fire_mode_t mode, long at)
+{
+    auart_init_t init = {
+        .ops = s->ops,
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+        .tx_policy = AUART_TX_PARTIAL,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    uint8_t seq = 0;
+    num_sent = 0;
+
+    if (s->skip)
+    {
+        CHECK(write_seq(&seq, s->skip, false) == s->skip);
+        drain();
+    }
+
+    int32_t first = num_sent;
+    int32_t accepted = 0;
+
+    if (s->busy_len)
+    {
+        CHECK(write_seq(&seq, s->busy_len, false) == s->busy_len);
+        CHECK(sim.tx_busy);
+        accepted += s->busy_len;
+    }
+
+    step = 0;
+    fire_step = at;
+    fire_mode = mode;
+    accepted += write_seq(&seq, s->len, true);
+    bool is_fired = step >= at;
+
+    // nothing is left behind an idle dma
+    CHECK(auart.tx_head == auart.tx_tail || sim.tx_busy);
+
+    drain();
+    CHECK(num_sent - first == accepted);
+    for (int32_t i = first; i < num_sent; i++)
+        CHECK(line[i] == (uint8_t)(line[first] + i - first));
+    CHECK(line[first] == (uint8_t)s->skip);
+    CHECK(auart.tx_dma_state == 0);
+
+    return is_fired;
+}
+
+int main(void)
+{
+    const scenario_t scenarios[] = {
+        {"idle", &sim_ops, 0, 0, 10},
+        {"idle wrap", &sim_ops, 56, 0, 20},
+        {"busy", &sim_ops, 0, 10, 10},
+        {"busy wrap", &sim_ops, 40, 10, 30},
+        {"busy full", &sim_ops, 0, 40, 40},
+        {"idle wrap", &sim_ops_queue, 56, 0, 20},
+        {"busy", &sim_ops_queue, 0, 10, 10},
+        {"busy wrap", &sim_ops_queue, 40, 10, 30},
+        {"queued", &sim_ops_queue, 56, 20, 10},
+    };
+
+    long runs = 0;
+    long total_fired = 0;
+
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+    {
+        const scenario_t *s = &scenarios[i];
+
+        // the first calls resolve the lazy bindings, keep them unstepped
+        run(s, FIRE_ONCE, 0);
+
+        long steps = 0;
+        for (fire_mode_t mode = FIRE_ONCE; mode <= FIRE_FROM; mode++)
+        {
+            fired = 0;
+            long at = 1;
+            while (run(s, mode, at))
+                at++;
+
+            steps = at - 1;
+            runs += at - 1;
+            total_fired += fired;
+        }
+
+        printf("test_claim: %-9s %-8s %4ld instructions, each one "
+               "interrupted\n",
+               s->name, s->ops->dma_tx_queue ? "queue" : "no queue", steps);
+    }
+
+    CHECK(total_fired > 0);
+
+    printf("test_claim: %ld interleavings, %ld completes inside auart_tx(), "
+           "no double start, nothing stranded\n",
+           runs, total_fired);
+
+    return 0;
+}
+
+#else
+
+int main(void)
+{
+    printf("test_claim: skipped, the stepping needs x86-64 Linux\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * @file test_dbm.c
+ * @brief The F407 double buffer RX port against a register-level DMA stream
+ *
+ * Builds the real `example/STM32F407/Core/Src/usart.c` on the mock HAL in
+ * `mock/`. The test plays the stream: each byte goes to the memory target
+ * selected by CR.CT at the offset given by NDTR, and when NDTR runs out it
+ * reloads, CT swaps between M0AR and M1AR and the transfer complete
+ * interrupt calls the M0 or M1 callback like `HAL_DMA_IRQHandler()`.
+ *
+ * The progress reported by the port must match the stream at every
+ * position, and stay whole when the swap lands between any two of its
+ * register reads (stepped like in test_claim.c, x86-64 Linux only). A
+ * restart must begin at the start of the buffer whichever target the
+ * stream was left on, and a stream driven by a timer signal must be read
+ * back through the driver with every gap reported.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+#include "usart.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define TEST_RX_SIZE 512
+#define TEST_BYTES 1000000L
+
+USART_TypeDef mock_usart1;
+DMA_Stream_TypeDef mock_dma2_stream2;
+DMA_Stream_TypeDef mock_dma2_stream7;
+GPIO_TypeDef mock_gpioa;
+
+extern DMA_HandleTypeDef hdma_usart1_rx;
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+
+static volatile long dropped;
+
+void Error_Handler(void)
+{
+    CHECK(0);
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+}
+
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart1)
+        auart_dma_rx_half_cplt_callback(&auart);
+}
+
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart == &huart1)
+        auart_dma_rx_cplt_callback(&auart);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    (void)huart;
+    CHECK(0);
+}
+
+// the memory address registers hold the low 32 bits of the host address
+static uint8_t *bus(uint32_t addr)
+{
+    uint32_t offset = addr - (uint32_t)(uintptr_t)rx_buffer;
+    CHECK(offset < TEST_RX_SIZE);
+    return rx_buffer + offset;
+}
+
+// one byte from the USART into the stream, the targets swap and the
+// complete interrupt fires when NDTR runs out.
+static void stream_byte(uint8_t c, bool with_irq)
+{
+    DMA_Stream_TypeDef *s = hdma_usart1_rx.Instance;
+    if (!(s->CR & DMA_SxCR_EN) || !(huart1.Instance->CR3 & USART_CR3_DMAR))
+    {
+        dropped++;
+        return;
+    }
+
+    uint32_t target = s->CR & DMA_SxCR_CT ? s->M1AR : s->M0AR;
+    *bus(target + s->NDTR_RELOAD - s->NDTR) = c;
+
+    if (--s->NDTR != 0)
+        return;
+
+    s->NDTR = s->NDTR_RELOAD;
+    s->CR ^= DMA_SxCR_CT;
+    s->ISR |= DMA_FLAG_TCIF;
+
+    if (!with_irq)
+        return;
+
+    // `HAL_DMA_IRQHandler()` in double buffer mode, CT already points to
+    // the next target.
+    s->ISR &= ~DMA_FLAG_TCIF;
+    if (s->CR & DMA_SxCR_CT)
+        hdma_usart1_rx.XferCpltCallback(&hdma_usart1_rx);
+    else
+        hdma_usart1_rx.XferM1CpltCallback(&hdma_usart1_rx);
+}
+
+static uint32_t progress(void)
+{
+    uint32_t bytes_left;
+    CHECK(uart_dma_rx_dbm_update_progress(&hdma_usart1_rx, &bytes_left) == 0);
+    return bytes_left;
+}
+
+static void stop(void)
+{
+    CHECK(uart_dma_rx_dbm_abort(&hdma_usart1_rx) == 0);
+    CHECK(!(hdma_usart1_rx.Instance->CR & DMA_SxCR_EN));
+}
+
+static void test_progress(uint32_t size)
+{
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, size) == 0);
+
+    // two laps, across both swaps
+    for (uint32_t pos = 0; pos < size * 2; pos++)
+    {
+        CHECK(progress() == size - pos % size);
+        stream_byte((uint8_t)pos, false);
+        CHECK(rx_buffer[pos % size] == (uint8_t)pos);
+    }
+
+    CHECK(progress() == size);
+    stop();
+}
+
+#if (SIM_STEP == 1)
+static volatile long step;
+static long swap_step;
+
+static void on_step(void)
+{
+    if (++step == swap_step)
+        stream_byte(0, false);
+}
+
+// the stream swaps targets between any two instructions of the progress
+// read, at the end of M0 and at the end of M1. the result must be the
+// count from before the swap or the one after, never a mix of the two.
+static long test_progress_swap(void)
+{
+    const uint32_t size = 16;
+    long interleavings = 0;
+
+    for (uint32_t pos = size / 2 - 1; pos < size; pos += size / 2)
+    {
+        uint32_t before = size - pos;
+        uint32_t after = before == 1 ? size : before - 1;
+
+        for (swap_step = 1;; swap_step++)
+        {
+            CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, size) == 0);
+            for (uint32_t i = 0; i < pos; i++)
+                stream_byte(0, false);
+            CHECK(progress() == before);
+
+            step = 0;
+            sim_step_begin(on_step);
+            uint32_t bytes_left = progress();
+            sim_step_end();
+
+            bool is_swapped = step >= swap_step;
+            CHECK(bytes_left == before || bytes_left == after);
+            CHECK(progress() == (is_swapped ? after : before));
+            stop();
+
+            if (!is_swapped)
+                break;
+            interleavings++;
+        }
+    }
+
+    return interleavings;
+}
+#endif
+
+static void test_start_args(void)
+{
+    // two halves of the same size, each within the 16 bits of NDTR
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, 7) < 0);
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, 0) < 0);
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer,
+                                2 * 0xFFFF + 2) < 0);
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, NULL, 8) < 0);
+}
+
+static void test_restart(void)
+{
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, TEST_RX_SIZE) == 0);
+
+    // stopped while writing into M1
+    for (int i = 0; i < TEST_RX_SIZE / 2 + 10; i++)
+        stream_byte(0, false);
+    CHECK(hdma_usart1_rx.Instance->CR & DMA_SxCR_CT);
+    stop();
+
+    // nothing lands in the buffer while stopped
+    long dropped_before = dropped;
+    stream_byte(1, false);
+    CHECK(dropped == dropped_before + 1);
+
+    // the driver restarts at the beginning of the buffer
+    CHECK(uart_dma_rx_dbm_start(&hdma_usart1_rx, rx_buffer, TEST_RX_SIZE) == 0);
+    CHECK(progress() == TEST_RX_SIZE);
+    stream_byte(0xA5, false);
+    CHECK(rx_buffer[0] == 0xA5);
+    CHECK(progress() == TEST_RX_SIZE - 1);
+    stop();
+}
+
+static uint8_t next_in;
+
+// `rand()` takes a lock the interrupted thread may hold
+static uint32_t irq_rand(void)
+{
+    static uint32_t x = 9;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// the USART receives a burst, then sometimes goes idle
+static void on_timer(int sig)
+{
+    (void)sig;
+
+    int burst = irq_rand() % 80;
+    for (int i = 0; i < burst; i++)
+        stream_byte(next_in++, true);
+
+    if (irq_rand() % 4 == 0)
+        auart_idle_callback(&auart);
+}
+
+static uint32_t get_tick_ms(void)
+{
+    return 0;
+}
+
+static const auart_ops_t dbm_ops = {
+    .dma_rx_start = uart_dma_rx_dbm_start,
+    .dma_rx_update_progress = uart_dma_rx_dbm_update_progress,
+    .dma_rx_abort = uart_dma_rx_dbm_abort,
+    .get_tick_ms = get_tick_ms,
+};
+
+static void test_stream(void)
+{
+    auart_init_t init = {
+        .ops = &dbm_ops,
+        .h_rxdma = &hdma_usart1_rx,
+        .dir = AUART_DIR_RX_ONLY,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = TEST_RX_SIZE,
+    };
+    CHECK(auart_init(&auart, &init) == AUART_OK);
+
+    signal(SIGALRM, on_timer);
+    struct itimerval timer = {{0, 50}, {0, 50}};
+    CHECK(setitimer(ITIMER_REAL, &timer, NULL) == 0);
+
+    uint8_t next_out = 0;
+    long read = 0;
+    long overruns = 0;
+    bool is_overrun = false;
+
+    while (read < TEST_BYTES)
+    {
+        uint8_t buffer[300];
+        int res = auart_rx(&auart, buffer, rand() % sizeof(buffer) + 1);
+
+        if (res == AUART_OVERRUN)
+        {
+            is_overrun = true;
+            overruns++;
+            continue;
+        }
+
+        CHECK(res >= 0);
+        if (res == 0)
+            continue;
+
+        if (is_overrun)
+            next_out = buffer[0];
+        is_overrun = false;
+
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+        read += res;
+    }
+
+    struct itimerval stop_timer = {{0, 0}, {0, 0}};
+    CHECK(setitimer(ITIMER_REAL, &stop_timer, NULL) == 0);
+
+    printf("test_dbm: %ld bytes read through the double buffer, "
+           "%ld overruns reported, no splice\n",
+           read, overruns);
+}
+
+int main(void)
+{
+    MX_USART1_UART_Init();
+    HAL_UART_MspInit(&huart1);
+    CHECK(huart1.hdmarx == &hdma_usart1_rx);
+
+    test_progress(TEST_RX_SIZE);
+    test_progress(200);
+#if (SIM_STEP == 1)
+    printf("test_dbm: %ld progress reads with the swap in between, "
+           "never torn\n",
+           test_progress_swap());
+#endif
+    test_start_args();
+    test_restart();
+    test_stream();
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file test_deferred.c
+ * @brief The TX DMA started from the deferred handler only
+ *
+ * Built with `CONFIG_AUART_TX_DEFERRED_KICK`. The simulated
+ * `pend_deferred()` only sets a pending flag, and `dma_tx_start()` fails
+ * unless it is called from `auart_deferred_handler()`, so neither
+ * `auart_tx()` nor `auart_tx_cplt_callback()` may start the DMA.
+ *
+ * The kicks are first followed one by one. Then a timer signal plays the
+ * DMA complete interrupt, and a second, lower priority timer signal runs
+ * the pending handler like PendSV, preempting `auart_tx()` but never the
+ * complete interrupt. The bytes must come out exactly as they were
+ * written.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#if (CONFIG_AUART_TX_DEFERRED_KICK != 1)
+#error "the test needs CONFIG_AUART_TX_DEFERRED_KICK"
+#endif
+
+#define TEST_BYTES 2000000L
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 512
+#endif
+
+static auart_t auart;
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+static uint8_t line[TEST_BYTES + TEST_TX_SIZE];
+static volatile long num_sent;
+
+static void start(const auart_ops_t *ops)
+{
+    auart_init_t init = {
+        .ops = ops,
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+        .tx_policy = AUART_TX_PARTIAL,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+    num_sent = 0;
+}
+
+static void check_line(long len)
+{
+    CHECK(num_sent == len);
+    for (long i = 0; i < len; i++)
+        CHECK(line[i] == (uint8_t)i);
+}
+
+static void test_steps(const auart_ops_t *ops)
+{
+    start(ops);
+
+    uint8_t data[20];
+    for (int i = 0; i < 20; i++)
+        data[i] = (uint8_t)i;
+
+    // the write only pends the handler
+    CHECK(auart_tx(&auart, data, 10) == 10);
+    CHECK(sim.deferred_pending && !sim.tx_busy);
+    CHECK(sim.tx_starts == 0);
+
+    CHECK(sim_run_deferred());
+    CHECK(sim.tx_busy && sim.tx_starts == 1);
+    CHECK(!sim.deferred_pending);
+
+    // the dma is running, nothing to pend
+    long pends = sim.deferred_pends;
+    CHECK(auart_tx(&auart, data + 10, 10) == 10);
+    CHECK(sim.deferred_pends == pends);
+
+    // the complete interrupt pends the handler for the rest
+    num_sent += sim_tx_complete(line + num_sent);
+    CHECK(!sim.tx_busy && sim.deferred_pending);
+    CHECK(sim.tx_starts == 1);
+    CHECK(sim_run_deferred());
+    CHECK(sim.tx_busy && sim.tx_starts == 2);
+
+    // nothing left, nothing pended
+    pends = sim.deferred_pends;
+    while (sim.tx_busy)
+        num_sent += sim_tx_complete(line + num_sent);
+    CHECK(sim.deferred_pends == pends && !sim.deferred_pending);
+
+    check_line(20);
+    CHECK(auart.tx_dma_state == 0);
+}
+
+// `rand()` takes a lock the interrupted thread may hold
+static uint32_t irq_rand(void)
+{
+    static uint32_t x = 5;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// the dma complete interrupt, which masks the deferred handler
+static void on_dma(int sig)
+{
+    (void)sig;
+
+    // the transfer is not always done yet
+    if (irq_rand() % 4 != 0)
+        num_sent += sim_tx_complete(line + num_sent);
+}
+
+// the deferred handler, at the lowest interrupt priority
+static void on_deferred(int sig)
+{
+    (void)sig;
+    sim_run_deferred();
+}
+
+static void test_stream(const auart_ops_t *ops)
+{
+    start(ops);
+
+    sigset_t irqs;
+    sigemptyset(&irqs);
+    sigaddset(&irqs, SIGALRM);
+    sigaddset(&irqs, SIGUSR1);
+
+    struct sigaction sa = {0};
+    sa.sa_handler = on_deferred;
+    sigemptyset(&sa.sa_mask);
+    CHECK(sigaction(SIGUSR1, &sa, NULL) == 0);
+
+    sa.sa_handler = on_dma;
+    sigaddset(&sa.sa_mask, SIGUSR1);
+    CHECK(sigaction(SIGALRM, &sa, NULL) == 0);
+
+    timer_t timer_deferred;
+    struct sigevent ev = {0};
+    ev.sigev_notify = SIGEV_SIGNAL;
+    ev.sigev_signo = SIGUSR1;
+    CHECK(timer_create(CLOCK_MONOTONIC, &ev, &timer_deferred) == 0);
+
+    struct itimerspec spec = {{0, 13000}, {0, 13000}};
+    CHECK(timer_settime(timer_deferred, 0, &spec, NULL) == 0);
+    struct itimerval timer = {{0, 20}, {0, 20}};
+    CHECK(setitimer(ITIMER_REAL, &timer, NULL) == 0);
+
+    long written = 0;
+    while (written < TEST_BYTES)
+    {
+        uint8_t data[100];
+        int32_t len = rand() % sizeof(data) + 1;
+        if (len > TEST_BYTES - written)
+            len = TEST_BYTES - written;
+
+        for (int32_t i = 0; i < len; i++)
+            data[i] = (uint8_t)(written + i);
+
+        int res = auart_tx(&auart, data, len);
+        CHECK(res >= 0 && res <= len);
+        written += res;
+    }
+
+    struct itimerval stop_timer = {{0, 0}, {0, 0}};
+    CHECK(setitimer(ITIMER_REAL, &stop_timer, NULL) == 0);
+    CHECK(timer_delete(timer_deferred) == 0);
+    sigprocmask(SIG_BLOCK, &irqs, NULL);
+
+    // the last kick may still be pending
+    while (sim.tx_busy || sim_run_deferred())
+        num_sent += sim_tx_complete(line + num_sent);
+
+    check_line(written);
+    CHECK(auart.tx_head == auart.tx_tail && auart.tx_dma_state == 0);
+
+    sigprocmask(SIG_UNBLOCK, &irqs, NULL);
+
+    printf("test_deferred: %-8s %ld bytes in %ld transfers, %ld pends, "
+           "%ld handler runs, started from the handler only\n",
+           ops->dma_tx_queue ? "queue" : "no queue", written,
+           sim.tx_starts + sim.tx_queues, sim.deferred_pends,
+           sim.deferred_runs);
+}
+
+int main(void)
+{
+    test_steps(&sim_ops);
+    test_steps(&sim_ops_queue);
+    test_stream(&sim_ops);
+    test_stream(&sim_ops_queue);
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file test_frame.c
+ * @brief The frame queue with the RX interrupts preempting each other
+ *
+ * The main loop plays the DMA and its half and complete interrupts, a
+ * timer signal plays a higher priority IDLE interrupt and `auart_tick()`,
+ * so the frame close nests into itself and into `auart_rx_frame()`. The
+ * frames read back must be the received bytes, each exactly once and in
+ * order.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE == 0)
+#error "build with CONFIG_AUART_RX_FRAME_QUEUE_SIZE set"
+#endif
+
+#ifndef TEST_RX_SIZE
+#define TEST_RX_SIZE 256
+#endif
+#define TEST_BYTES 64000000L
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+
+static volatile long nested_events;
+
+static void on_timer(int sig)
+{
+    (void)sig;
+
+    if (nested_events++ % 2)
+        sim_rx_idle();
+    else
+        CHECK(auart_tick(&auart) >= 0);
+}
+
+int main(void)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_RX_ONLY,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = TEST_RX_SIZE,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    signal(SIGALRM, on_timer);
+    struct itimerval timer = {{0, 50}, {0, 50}};
+    CHECK(setitimer(ITIMER_REAL, &timer, NULL) == 0);
+
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    long received = 0;
+    long read = 0;
+    long frames = 0;
+    bool is_done = false;
+
+    srand(7);
+
+    while (!is_done)
+    {
+        if (received < TEST_BYTES)
+        {
+            // each burst ends on an idle line and the reader drains it,
+            // no overrun
+            int burst = rand() % (TEST_RX_SIZE / 2 + 1);
+            for (int i = 0; i < burst; i++)
+                sim_rx_byte(next_in++, true);
+            received += burst;
+
+            sim_rx_idle();
+        }
+        else
+        {
+            struct itimerval stop = {{0, 0}, {0, 0}};
+            CHECK(setitimer(ITIMER_REAL, &stop, NULL) == 0);
+            sim_rx_idle();
+            is_done = true;
+        }
+
+        uint8_t frame[TEST_RX_SIZE];
+        int res;
+        while ((res = auart_rx_frame(&auart, frame, sizeof(frame), NULL)) > 0)
+        {
+            for (int i = 0; i < res; i++)
+                CHECK(frame[i] == next_out++);
+            read += res;
+            frames++;
+        }
+
+        CHECK(res == 0);
+    }
+
+    CHECK(read == received);
+
+    printf("test_frame: %ld bytes in %ld frames, %ld nested events\n",
+           read, frames, (long)nested_events);
+
+    return 0;
+}
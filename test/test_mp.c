@@ -0,0 +1,412 @@
+/**
+ * @file test_mp.c
+ * @brief TX from the thread and from two nested interrupts at once
+ *
+ * Built with `CONFIG_AUART_TX_MULTI_PRODUCER`. Three producers write
+ * tagged records: the main loop with `auart_tx()`, a timer signal with
+ * `auart_tx_from_isr()`, and a second timer signal, which also plays the
+ * TX DMA complete interrupt and may preempt the first one, with
+ * `auart_txv()`. Each record carries its producer, a sequence number and
+ * a payload derived from both, so the line shows any record that is
+ * torn, reordered against the others of its producer, or missing.
+ *
+ * Whenever the main loop runs, no interrupt is inside the driver, and
+ * every claimed byte must be published and owned by a running transfer,
+ * never stranded until the next write.
+ *
+ * The writer that claims nothing because an interrupt filled the buffer
+ * after it entered, and is then the last one out, has to publish the
+ * interrupt's record. `auart_tx()` is single stepped with the interrupt
+ * writing at every instruction to hit that path (x86-64 Linux only).
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#if (CONFIG_AUART_TX_MULTI_PRODUCER != 1)
+#error "the test needs CONFIG_AUART_TX_MULTI_PRODUCER"
+#endif
+
+#define TEST_BYTES 2000000L
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 512
+#endif
+
+#define RECORD_TAG 0xA0
+#define RECORD_HEADER 4
+#define RECORD_MAX_PAYLOAD 28
+
+enum
+{
+    SRC_THREAD,
+    SRC_ISR,
+    SRC_ISR_TXV,
+    SRC_COUNT,
+};
+
+static auart_t auart;
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+static uint8_t line[TEST_BYTES + TEST_TX_SIZE * 4];
+static volatile long num_sent;
+
+// each counted by its own producer only, an interrupt may preempt the
+// update of another one.
+static volatile long accepted[SRC_COUNT];
+static volatile long accepted_bytes[SRC_COUNT];
+static volatile long rejected;
+
+// a record is the tag with its producer, the 16-bit sequence number, the
+// payload length, then the payload.
+static int32_t make_header(uint8_t *out, int src, int32_t payload_len)
+{
+    uint16_t seq = (uint16_t)accepted[src];
+    out[0] = (uint8_t)(RECORD_TAG | src);
+    out[1] = (uint8_t)seq;
+    out[2] = (uint8_t)(seq >> 8);
+    out[3] = (uint8_t)payload_len;
+    return RECORD_HEADER;
+}
+
+static void make_payload(uint8_t *out, int src, int32_t payload_len)
+{
+    uint16_t seq = (uint16_t)accepted[src];
+    for (int32_t i = 0; i < payload_len; i++)
+        out[i] = (uint8_t)(seq * 7 + i * 13 + src);
+}
+
+static void on_written(int src, int32_t len, int res)
+{
+    CHECK(res == 0 || res == len);
+    if (res == 0)
+    {
+        rejected++;
+        return;
+    }
+
+    accepted[src]++;
+    accepted_bytes[src] += len;
+}
+
+static long total_accepted_bytes(void)
+{
+    long total = 0;
+    for (int src = 0; src < SRC_COUNT; src++)
+        total += accepted_bytes[src];
+    return total;
+}
+
+static void check_line(void)
+{
+    long next_seq[SRC_COUNT] = {0};
+
+    long pos = 0;
+    while (pos < num_sent)
+    {
+        CHECK(num_sent - pos >= RECORD_HEADER);
+        const uint8_t *r = line + pos;
+
+        CHECK((r[0] & 0xF0) == RECORD_TAG);
+        int src = r[0] & 0x0F;
+        CHECK(src < SRC_COUNT);
+
+        uint16_t seq = (uint16_t)(r[1] | r[2] << 8);
+        CHECK(seq == (uint16_t)next_seq[src]);
+
+        int32_t payload_len = r[3];
+        CHECK(payload_len <= RECORD_MAX_PAYLOAD);
+        CHECK(num_sent - pos >= RECORD_HEADER + payload_len);
+        for (int32_t i = 0; i < payload_len; i++)
+            CHECK(r[RECORD_HEADER + i] == (uint8_t)(seq * 7 + i * 13 + src));
+
+        next_seq[src]++;
+        pos += RECORD_HEADER + payload_len;
+    }
+
+    for (int src = 0; src < SRC_COUNT; src++)
+        CHECK(next_seq[src] == accepted[src]);
+    CHECK(num_sent == total_accepted_bytes());
+}
+
+static void drain(void)
+{
+    while (sim.tx_busy)
+        num_sent += sim_tx_complete(line + num_sent);
+}
+
+// nothing claimed is left unpublished, nothing published is left behind
+// an idle dma.
+static void check_published(void)
+{
+    CHECK(auart.tx_claim == auart.tx_tail);
+    CHECK(auart.tx_head == auart.tx_tail || sim.tx_busy);
+}
+
+static void start(const auart_ops_t *ops)
+{
+    auart_init_t init = {
+        .ops = ops,
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+        .tx_policy = AUART_TX_ALL_OR_NOTHING,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    memset(line, 0, sizeof(line));
+    num_sent = 0;
+    rejected = 0;
+    for (int src = 0; src < SRC_COUNT; src++)
+    {
+        accepted[src] = 0;
+        accepted_bytes[src] = 0;
+    }
+}
+
+static void finish(void)
+{
+    drain();
+    check_line();
+    CHECK(auart.tx_head == auart.tx_tail);
+    CHECK(auart.tx_claim == auart.tx_tail);
+    CHECK(auart.tx_dma_state == 0);
+}
+
+static int thread_write(int32_t payload_len)
+{
+    uint8_t record[RECORD_HEADER + RECORD_MAX_PAYLOAD];
+    int32_t len = make_header(record, SRC_THREAD, payload_len);
+    make_payload(record + len, SRC_THREAD, payload_len);
+    len += payload_len;
+
+    int res = auart_tx(&auart, record, len);
+    on_written(SRC_THREAD, len, res);
+    return res;
+}
+
+static int isr_write(int32_t payload_len)
+{
+    uint8_t record[RECORD_HEADER + RECORD_MAX_PAYLOAD];
+    int32_t len = make_header(record, SRC_ISR, payload_len);
+    make_payload(record + len, SRC_ISR, payload_len);
+    len += payload_len;
+
+    int res = auart_tx_from_isr(&auart, record, len);
+    on_written(SRC_ISR, len, res);
+    return res;
+}
+
+static int isr_txv_write(int32_t payload_len)
+{
+    uint8_t header[RECORD_HEADER];
+    uint8_t payload[RECORD_MAX_PAYLOAD];
+    make_header(header, SRC_ISR_TXV, payload_len);
+    make_payload(payload, SRC_ISR_TXV, payload_len);
+
+    auart_iovec_t iov[2] = {
+        {header, RECORD_HEADER},
+        {payload, payload_len},
+    };
+    int res = auart_txv(&auart, iov, 2);
+    on_written(SRC_ISR_TXV, RECORD_HEADER + payload_len, res);
+    return res;
+}
+
+// `rand()` takes a lock the interrupted thread may hold, and each
+// interrupt has its own state as one preempts the other.
+static uint32_t xorshift(uint32_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return *x;
+}
+
+static volatile bool is_in_isr;
+static volatile long nested;
+static volatile bool is_stopped;
+
+// the lower priority interrupt, preempted by the one below
+static void on_isr(int sig)
+{
+    (void)sig;
+    static uint32_t x = 7;
+
+    is_in_isr = true;
+    if (!is_stopped && total_accepted_bytes() < TEST_BYTES)
+        isr_write(xorshift(&x) % (RECORD_MAX_PAYLOAD + 1));
+    is_in_isr = false;
+}
+
+// the higher priority interrupt, the dma completes then a record is
+// written from the same interrupt.
+static void on_isr_txv(int sig)
+{
+    (void)sig;
+    static uint32_t x = 11;
+
+    if (is_in_isr)
+        nested++;
+
+    num_sent += sim_tx_complete(line + num_sent);
+    if (!is_stopped && total_accepted_bytes() < TEST_BYTES)
+        isr_txv_write(xorshift(&x) % (RECORD_MAX_PAYLOAD + 1));
+}
+
+static void test_stress(const auart_ops_t *ops)
+{
+    start(ops);
+    is_stopped = false;
+    nested = 0;
+
+    sigset_t irqs;
+    sigemptyset(&irqs);
+    sigaddset(&irqs, SIGALRM);
+    sigaddset(&irqs, SIGUSR1);
+
+    struct sigaction sa = {0};
+    sa.sa_handler = on_isr;
+    sigemptyset(&sa.sa_mask);
+    CHECK(sigaction(SIGALRM, &sa, NULL) == 0);
+
+    sa.sa_handler = on_isr_txv;
+    sigaddset(&sa.sa_mask, SIGALRM);
+    CHECK(sigaction(SIGUSR1, &sa, NULL) == 0);
+
+    timer_t timer_txv;
+    struct sigevent ev = {0};
+    ev.sigev_notify = SIGEV_SIGNAL;
+    ev.sigev_signo = SIGUSR1;
+    CHECK(timer_create(CLOCK_MONOTONIC, &ev, &timer_txv) == 0);
+
+    struct itimerspec spec_txv = {{0, 17000}, {0, 17000}};
+    CHECK(timer_settime(timer_txv, 0, &spec_txv, NULL) == 0);
+    struct itimerval timer = {{0, 30}, {0, 30}};
+    CHECK(setitimer(ITIMER_REAL, &timer, NULL) == 0);
+
+    long writes = 0;
+    while (total_accepted_bytes() < TEST_BYTES)
+    {
+        thread_write(rand() % (RECORD_MAX_PAYLOAD + 1));
+        writes++;
+
+        // the interrupts are masked while looking
+        sigprocmask(SIG_BLOCK, &irqs, NULL);
+        check_published();
+        sigprocmask(SIG_UNBLOCK, &irqs, NULL);
+    }
+
+    struct itimerval stop_timer = {{0, 0}, {0, 0}};
+    CHECK(setitimer(ITIMER_REAL, &stop_timer, NULL) == 0);
+    CHECK(timer_delete(timer_txv) == 0);
+    is_stopped = true;
+
+    sigprocmask(SIG_BLOCK, &irqs, NULL);
+    finish();
+    sigprocmask(SIG_UNBLOCK, &irqs, NULL);
+
+    CHECK(accepted[SRC_ISR] > 0 && accepted[SRC_ISR_TXV] > 0);
+    CHECK(nested > 0);
+
+    printf("test_mp: %-8s %ld bytes in %ld/%ld/%ld records "
+           "(thread/isr/txv), %ld rejected, %ld nested, none torn\n",
+           ops->dma_tx_queue ? "queue" : "no queue", (long)num_sent,
+           accepted[SRC_THREAD], accepted[SRC_ISR], accepted[SRC_ISR_TXV],
+           rejected, nested);
+}
+
+#if (SIM_STEP == 1)
+static volatile long step;
+static long write_step;
+
+static void on_step(void)
+{
+    if (++step == write_step)
+        isr_write(10);
+}
+
+// returns false once `write_step` is past the end of the stepped call
+static bool run_stepped(const auart_ops_t *ops, int32_t room, long at,
+                        long *claimed_nothing)
+{
+    start(ops);
+
+    // the dma runs the first record, the buffer is left with `room`
+    int32_t left = TEST_TX_SIZE - room;
+    while (left > 0)
+    {
+        int32_t len = left < RECORD_HEADER + RECORD_MAX_PAYLOAD
+                          ? left
+                          : RECORD_HEADER + RECORD_MAX_PAYLOAD;
+        if (left - len > 0 && left - len < RECORD_HEADER)
+            len = left - RECORD_HEADER;
+
+        CHECK(thread_write(len - RECORD_HEADER) == len);
+        left -= len;
+    }
+
+    step = 0;
+    write_step = at;
+
+    sim_step_begin(on_step);
+    int res = thread_write(10);
+    sim_step_end();
+
+    bool is_written = step >= at;
+
+    // the interrupt took the room after `auart_tx()` entered, which then
+    // left last with nothing of its own to publish.
+    if (res == 0 && is_written)
+        (*claimed_nothing)++;
+
+    check_published();
+    finish();
+
+    return is_written;
+}
+
+static void test_stepped(const auart_ops_t *ops)
+{
+    // room for one of the two records, or for both
+    const int32_t rooms[] = {20, 28};
+
+    long runs = 0;
+    long claimed_nothing = 0;
+
+    for (size_t i = 0; i < sizeof(rooms) / sizeof(rooms[0]); i++)
+    {
+        // the first call resolves the lazy bindings, keep it unstepped
+        run_stepped(ops, rooms[i], 0, &claimed_nothing);
+
+        long at = 1;
+        while (run_stepped(ops, rooms[i], at, &claimed_nothing))
+            at++;
+        runs += at - 1;
+    }
+
+    CHECK(claimed_nothing > 0);
+
+    printf("test_mp: %-8s %ld interleavings, %ld with the thread claiming "
+           "nothing and publishing the interrupt's record\n",
+           ops->dma_tx_queue ? "queue" : "no queue", runs, claimed_nothing);
+}
+#endif
+
+int main(void)
+{
+#if (SIM_STEP == 1)
+    test_stepped(&sim_ops);
+    test_stepped(&sim_ops_queue);
+#endif
+    test_stress(&sim_ops);
+    test_stress(&sim_ops_queue);
+
+    return 0;
+}
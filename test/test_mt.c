@@ -0,0 +1,245 @@
+/**
+ * @file test_mt.c
+ * @brief The TX and RX paths against an interrupt running on another core
+ *
+ * A second thread plays the DMA and its interrupts, truly in parallel
+ * with the API calls in the main thread, so every interleaving of the
+ * lock-free paths gets a chance to happen. The TX thread sends each
+ * running transfer and calls `auart_tx_cplt_callback()`, the RX thread
+ * writes bytes into the ring and calls the IDLE, half and complete
+ * callbacks. The bytes must come out exactly as they went in.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#if (CONFIG_AUART_USE_C11_ATOMICS != 1)
+#error "the threads share the driver state through C11 atomics"
+#endif
+
+#define TEST_BYTES 16000000L
+#ifndef TEST_RX_SIZE
+#define TEST_RX_SIZE 512
+#endif
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 512
+#endif
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+// tx dma
+static const uint8_t *_Atomic tx_src;
+static _Atomic uint32_t tx_len;
+static _Atomic bool tx_busy;
+static _Atomic long tx_starts;
+
+// rx dma
+static _Atomic(uint8_t *) rx_dst;
+static _Atomic uint32_t rx_len;
+static _Atomic uint32_t rx_left;
+
+static int mt_rx_update_progress(void *hdma, uint32_t *out_bytes_left)
+{
+    (void)hdma;
+    *out_bytes_left = atomic_load(&rx_left);
+    return 0;
+}
+
+static int mt_rx_start(void *hdma, void *pdst, uint32_t len)
+{
+    (void)hdma;
+    atomic_store(&rx_dst, pdst);
+    atomic_store(&rx_len, len);
+    atomic_store(&rx_left, len);
+    return 0;
+}
+
+static int mt_abort(void *hdma)
+{
+    (void)hdma;
+    return 0;
+}
+
+static int mt_tx_start(void *hdma, const void *psrc, uint32_t len)
+{
+    (void)hdma;
+    atomic_store(&tx_src, psrc);
+    atomic_store(&tx_len, len);
+
+    // two owners of the dma at once
+    bool expected = false;
+    CHECK(atomic_compare_exchange_strong(&tx_busy, &expected, true));
+
+    atomic_fetch_add(&tx_starts, 1);
+    return 0;
+}
+
+static uint32_t mt_get_tick_ms(void)
+{
+    return 0;
+}
+
+static const auart_ops_t mt_ops = {
+    .dma_rx_update_progress = mt_rx_update_progress,
+    .dma_rx_start = mt_rx_start,
+    .dma_rx_abort = mt_abort,
+    .dma_tx_start = mt_tx_start,
+    .dma_tx_abort = mt_abort,
+    .get_tick_ms = mt_get_tick_ms,
+};
+
+static void *tx_irq_thread(void *arg)
+{
+    (void)arg;
+    uint8_t next_out = 0;
+    long sent = 0;
+
+    while (sent < TEST_BYTES)
+    {
+        if (!atomic_load(&tx_busy))
+        {
+            sched_yield();
+            continue;
+        }
+
+        const uint8_t *src = atomic_load(&tx_src);
+        uint32_t len = atomic_load(&tx_len);
+        for (uint32_t i = 0; i < len; i++)
+            CHECK(src[i] == next_out++);
+        sent += len;
+
+        atomic_store(&tx_busy, false);
+        CHECK(auart_tx_cplt_callback(&auart) >= 0);
+    }
+
+    return NULL;
+}
+
+static void *rx_irq_thread(void *arg)
+{
+    (void)arg;
+    uint8_t next_in = 0;
+    long received = 0;
+    uint32_t size = atomic_load(&rx_len);
+    uint8_t *dst = atomic_load(&rx_dst);
+
+    while (received < TEST_BYTES)
+    {
+        // never lap the reader, a real link would overrun here
+        uint32_t head = atomic_load(&auart.rx_head) % size;
+        uint32_t pos = size - atomic_load(&rx_left);
+        if ((pos + size - head) % size >= size - 64)
+        {
+            CHECK(auart_idle_callback(&auart) >= 0);
+            sched_yield();
+            continue;
+        }
+
+        for (int i = 0; i < 32 && received < TEST_BYTES; i++, received++)
+        {
+            uint32_t left = atomic_load(&rx_left);
+            atomic_store_explicit((_Atomic uint8_t *)&dst[size - left],
+                                  next_in++, memory_order_relaxed);
+
+            // the counter reloads at the end, the events fire like the
+            // hardware ones
+            left = left == 1 ? size : left - 1;
+            atomic_store(&rx_left, left);
+
+            if (left == size / 2)
+                CHECK(auart_dma_rx_half_cplt_callback(&auart) >= 0);
+            else if (left == size)
+                CHECK(auart_dma_rx_cplt_callback(&auart) >= 0);
+        }
+
+        CHECK(auart_idle_callback(&auart) >= 0);
+    }
+
+    return NULL;
+}
+
+static void on_timeout(int sig)
+{
+    (void)sig;
+    printf("test_mt: timed out, head %u tail %u state %u\n",
+           (unsigned)auart.tx_head, (unsigned)auart.tx_tail,
+           (unsigned)auart.tx_dma_state);
+    _exit(1);
+}
+
+int main(void)
+{
+    auart_init_t init = {
+        .ops = &mt_ops,
+        .h_rxdma = (void *)1,
+        .h_txdma = (void *)2,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = sizeof(rx_buffer),
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = sizeof(tx_buffer),
+    };
+    CHECK(auart_init(&auart, &init) == AUART_OK);
+
+    signal(SIGALRM, on_timeout);
+    alarm(60);
+
+    pthread_t tx_thread, rx_thread;
+    CHECK(pthread_create(&tx_thread, NULL, tx_irq_thread, NULL) == 0);
+    CHECK(pthread_create(&rx_thread, NULL, rx_irq_thread, NULL) == 0);
+
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    long written = 0;
+    long read = 0;
+
+    srand(5);
+
+    while (written < TEST_BYTES || read < TEST_BYTES)
+    {
+        long progress = written + read;
+
+        if (written < TEST_BYTES)
+        {
+            uint8_t data[64];
+            int32_t len = rand() % sizeof(data);
+            if (len > TEST_BYTES - written)
+                len = TEST_BYTES - written;
+            for (int32_t i = 0; i < len; i++)
+                data[i] = (uint8_t)(next_in + i);
+
+            int res = auart_tx(&auart, data, len);
+            CHECK(res >= 0);
+            next_in += res;
+            written += res;
+        }
+
+        uint8_t buffer[300];
+        int res = auart_rx(&auart, buffer, rand() % sizeof(buffer) + 1);
+        CHECK(res >= 0);
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+        read += res;
+
+        // let the interrupt threads run on a single core
+        if (written + read == progress)
+            sched_yield();
+    }
+
+    CHECK(pthread_join(tx_thread, NULL) == 0);
+    CHECK(pthread_join(rx_thread, NULL) == 0);
+
+    printf("test_mt: %ld bytes each way, %ld tx dma starts, no loss\n",
+           TEST_BYTES, (long)tx_starts);
+
+    return 0;
+}
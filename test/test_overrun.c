@@ -0,0 +1,449 @@
+/**
+ * @file test_overrun.c
+ * @brief Every lost byte is reported, and only lost bytes are
+ *
+ * With AUART_RX_OVERRUN_OVERWRITE_OLDEST the DMA may lap the reader
+ * between two interrupts, the data read must then be dropped with
+ * AUART_OVERRUN instead of being returned spliced with the new bytes.
+ * With AUART_RX_OVERRUN_DROP_NEWEST the restart of the DMA reports an
+ * overrun only if bytes arrived while it was stopped.
+ *
+ * With AUART_RX_OVERRUN_FLOW_CONTROL the sender is paused past half of
+ * the buffer and resumed at a quarter, and one that ignores the pause
+ * gets its loss reported once. An interrupt pausing again at every
+ * instruction of the resume must leave the sender paused (stepped like
+ * in test_claim.c, x86-64 Linux only).
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+
+#ifndef TEST_RX_SIZE
+#define TEST_RX_SIZE 128
+#endif
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+
+static void init(void)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_RX_ONLY,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = TEST_RX_SIZE,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+}
+
+#if (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_OVERWRITE_OLDEST)
+
+// the ring is full and the dma writes 10 more bytes before any interrupt
+static void fill_and_lap(uint8_t *next_in)
+{
+    for (int i = 0; i < TEST_RX_SIZE; i++)
+        sim_rx_byte((*next_in)++, true);
+
+    for (int i = 0; i < 10; i++)
+        sim_rx_byte((*next_in)++, false);
+}
+
+static void test_lap_rx(void)
+{
+    init();
+
+    uint8_t next_in = 0;
+    fill_and_lap(&next_in);
+
+    uint8_t buffer[TEST_RX_SIZE];
+    CHECK(auart_rx(&auart, buffer, sizeof(buffer)) == AUART_OVERRUN);
+
+    // then the bytes the dma left, and the new ones
+    sim_rx_idle();
+
+    uint8_t next_out = 10;
+    int res;
+    while ((res = auart_rx(&auart, buffer, sizeof(buffer))) > 0)
+    {
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+    }
+
+    CHECK(res == 0);
+    CHECK(next_out == next_in);
+}
+
+static void test_lap_peek(void)
+{
+    init();
+
+    uint8_t next_in = 0;
+    fill_and_lap(&next_in);
+
+    // the peeked data is overwritten before it is consumed
+    auart_span_t spans[2];
+    CHECK(auart_rx_peek(&auart, spans) == TEST_RX_SIZE);
+    CHECK(auart_rx_consume(&auart, TEST_RX_SIZE) == AUART_OVERRUN);
+
+    // with CONFIG_AUART_RX_POLL_DMA the new bytes are already there
+    CHECK(auart_rx_peek(&auart, spans) >= TEST_RX_SIZE - 10);
+    CHECK(spans[0].data[0] == 10);
+}
+
+// random bursts, part of them unseen by the interrupts, and a slow reader.
+// a read never returns spliced data, and a gap between two reads is
+// always announced.
+static void test_lap_random(void)
+{
+    init();
+
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    long received = 0;
+    long read = 0;
+    long overruns = 0;
+    bool is_overrun = false;
+
+    srand(8);
+
+    while (received < 2000000)
+    {
+        int burst = rand() % (TEST_RX_SIZE * 2);
+        for (int i = 0; i < burst; i++)
+            sim_rx_byte(next_in++, true);
+
+        // the unseen bytes stop short of the next half or complete event,
+        // the interrupts see every half of the buffer and the dma never
+        // gets a whole buffer ahead of them.
+        int to_event = sim.rx_left > TEST_RX_SIZE / 2
+                           ? sim.rx_left - TEST_RX_SIZE / 2
+                           : sim.rx_left;
+        int unseen = rand() % to_event;
+        for (int i = 0; i < unseen; i++)
+            sim_rx_byte(next_in++, false);
+
+        received += burst + unseen;
+
+        if (rand() % 2)
+            sim_rx_idle();
+
+        int reads = rand() % 3;
+        while (reads-- > 0)
+        {
+            uint8_t buffer[TEST_RX_SIZE];
+            int res;
+
+            if (rand() % 2)
+            {
+                res = auart_rx(&auart, buffer, rand() % TEST_RX_SIZE + 1);
+            }
+            else
+            {
+                auart_span_t spans[2];
+                res = auart_rx_peek(&auart, spans);
+                if (res > 0)
+                {
+                    res = rand() % res + 1;
+                    for (int i = 0; i < res; i++)
+                        buffer[i] = i < spans[0].len
+                                        ? spans[0].data[i]
+                                        : spans[1].data[i - spans[0].len];
+
+                    int consumed = auart_rx_consume(&auart, res);
+                    CHECK(consumed == res || consumed == AUART_OVERRUN);
+                    if (consumed < 0)
+                        res = consumed;
+                }
+            }
+
+            if (res == AUART_OVERRUN)
+            {
+                is_overrun = true;
+                overruns++;
+                continue;
+            }
+
+            CHECK(res >= 0);
+            if (res == 0)
+                continue;
+
+            if (is_overrun)
+                next_out = buffer[0];
+            is_overrun = false;
+
+            for (int i = 0; i < res; i++)
+                CHECK(buffer[i] == next_out++);
+            read += res;
+        }
+    }
+
+    CHECK(overruns > 0);
+
+    printf("test_overrun: %ld bytes received, %ld read, %ld overruns "
+           "reported, no splice\n",
+           received, read, overruns);
+}
+
+int main(void)
+{
+    test_lap_rx();
+    test_lap_peek();
+    test_lap_random();
+
+    return 0;
+}
+
+#elif (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_DROP_NEWEST)
+
+// past the half of the buffer, the next idle stops the dma
+static void fill_and_pause(uint8_t *next_in)
+{
+    for (int i = 0; i < TEST_RX_SIZE / 2 + 1; i++)
+        sim_rx_byte((*next_in)++, true);
+    sim_rx_idle();
+
+    CHECK(!sim.rx_running);
+}
+
+// the last read restarts the dma, the one after tells if bytes were lost
+static int drain(uint8_t *next_out)
+{
+    uint8_t buffer[TEST_RX_SIZE];
+    int res;
+    while ((res = auart_rx(&auart, buffer, sizeof(buffer))) > 0)
+    {
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == (*next_out)++);
+    }
+
+    return res;
+}
+
+int main(void)
+{
+    init();
+
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    uint8_t buffer[TEST_RX_SIZE];
+
+    // nothing arrives while stopped, the restart reports nothing
+    fill_and_pause(&next_in);
+    CHECK(drain(&next_out) == 0);
+    CHECK(sim.rx_running && sim.rx_starts == 2);
+    CHECK(auart_rx(&auart, buffer, sizeof(buffer)) == 0);
+
+    // the ring starts over from its beginning after a restart
+    fill_and_pause(&next_in);
+
+    // bytes arrive while stopped, the restart reports them once
+    for (int i = 0; i < 5; i++)
+        sim_rx_byte(next_in++, true);
+
+    CHECK(drain(&next_out) == AUART_OVERRUN);
+    CHECK(sim.rx_running && sim.rx_starts == 3);
+    CHECK(auart_rx(&auart, buffer, sizeof(buffer)) == 0);
+
+    // the stream goes on after the dropped bytes
+    next_out = next_in;
+    for (int i = 0; i < 10; i++)
+        sim_rx_byte(next_in++, true);
+    sim_rx_idle();
+    CHECK(drain(&next_out) == 0);
+    CHECK(next_out == next_in);
+
+    printf("test_overrun: drop newest restarts report only lost bytes\n");
+
+    return 0;
+}
+
+#elif (CONFIG_AUART_RX_OVERRUN_POLICY == AUART_RX_OVERRUN_FLOW_CONTROL)
+
+static uint8_t next_in;
+static uint8_t next_out;
+
+static int read_checked(int32_t len)
+{
+    uint8_t buffer[TEST_RX_SIZE];
+    int res = auart_rx(&auart, buffer, len);
+    for (int i = 0; i < res; i++)
+        CHECK(buffer[i] == next_out++);
+    return res;
+}
+
+// every byte received has been announced by an interrupt
+static int waiting(void)
+{
+    return (uint8_t)(next_in - next_out);
+}
+
+// half of the buffer seen by the half event does not pause the sender, a
+// byte more seen by the idle one does.
+static void fill_and_pause(void)
+{
+    for (int i = 0; i < TEST_RX_SIZE / 2; i++)
+        sim_rx_byte(next_in++, true);
+    CHECK(!sim.rx_flow_paused && sim.rx_flow_pauses == 0);
+
+    sim_rx_byte(next_in++, false);
+    sim_rx_idle();
+    CHECK(sim.rx_flow_paused && sim.rx_flow_pauses == 1);
+    CHECK(auart.rx_paused);
+}
+
+static void test_pause_resume(void)
+{
+    init();
+    next_in = 0;
+    next_out = 0;
+    CHECK(!sim.rx_flow_paused && sim.rx_flow_resumes == 1);
+
+    fill_and_pause();
+
+    // a sender that stops a few bytes late is paused only once
+    for (int i = 0; i < 5; i++)
+        sim_rx_byte(next_in++, true);
+    sim_rx_idle();
+    CHECK(sim.rx_flow_pauses == 1);
+
+    // the read that leaves a quarter resumes
+    while (waiting() > TEST_RX_SIZE / 4 + 1)
+        CHECK(read_checked(1) == 1);
+    CHECK(sim.rx_flow_paused && sim.rx_flow_resumes == 1);
+
+    CHECK(read_checked(1) == 1);
+    CHECK(!sim.rx_flow_paused && sim.rx_flow_resumes == 2);
+    CHECK(!auart.rx_paused);
+
+    while (read_checked(TEST_RX_SIZE) > 0)
+        ;
+    CHECK(next_out == next_in);
+    CHECK(sim.rx_flow_pauses == 1 && sim.rx_flow_resumes == 2);
+}
+
+// a sender ignoring RTS laps the reader several times, the loss is still
+// reported once.
+static void test_ignored(void)
+{
+    init();
+    next_in = 0;
+    next_out = 0;
+
+    fill_and_pause();
+    for (int i = 0; i < TEST_RX_SIZE * 3; i++)
+        sim_rx_byte(next_in++, true);
+    sim_rx_idle();
+
+    int overruns = 0;
+    int res;
+    uint8_t buffer[TEST_RX_SIZE];
+    while ((res = auart_rx(&auart, buffer, sizeof(buffer))) != 0)
+    {
+        if (res == AUART_OVERRUN)
+        {
+            overruns++;
+            next_out = next_in - TEST_RX_SIZE;
+            continue;
+        }
+
+        CHECK(res > 0);
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+    }
+
+    CHECK(overruns == 1);
+    CHECK(next_out == next_in);
+    CHECK(!sim.rx_flow_paused);
+}
+
+#if (SIM_STEP == 1)
+static volatile long step;
+static long fire_step;
+
+// late bytes and their idle interrupt, enough to pause the sender again
+static void on_step(void)
+{
+    if (++step != fire_step)
+        return;
+
+    for (int i = 0; i < TEST_RX_SIZE / 4 + 1; i++)
+        sim_rx_byte(next_in++, false);
+    sim_rx_idle();
+}
+
+// returns false once `fire_step` is past the end of the stepped call
+static bool run_resume(long at, long *repaused)
+{
+    init();
+    next_in = 0;
+    next_out = 0;
+
+    fill_and_pause();
+    while (waiting() > TEST_RX_SIZE / 4 + 1)
+        CHECK(read_checked(1) == 1);
+
+    // the read resumes, then the interrupt pauses again
+    step = 0;
+    fire_step = at;
+    sim_step_begin(on_step);
+    int res = read_checked(1);
+    sim_step_end();
+
+    bool is_fired = at > 0 && step >= at;
+    CHECK(res == 1);
+
+    // the last word on the line is the driver's
+    CHECK(sim.rx_flow_paused == (auart.rx_paused != 0));
+    if (is_fired && sim.rx_flow_resumes == 2 && sim.rx_flow_pauses == 2)
+    {
+        CHECK(sim.rx_flow_paused);
+        (*repaused)++;
+    }
+
+    while (read_checked(TEST_RX_SIZE) > 0)
+        ;
+    CHECK(next_out == next_in);
+    CHECK(!sim.rx_flow_paused);
+
+    return is_fired;
+}
+
+static void test_resume_race(void)
+{
+    long repaused = 0;
+
+    // the first call resolves the lazy bindings, keep it unstepped
+    run_resume(0, &repaused);
+
+    long at = 1;
+    while (run_resume(at, &repaused))
+        at++;
+
+    CHECK(repaused > 0);
+
+    printf("test_overrun: %ld interleavings of the resume, %ld paused "
+           "again once resumed, the sender always left paused\n",
+           at - 1, repaused);
+}
+#endif
+
+int main(void)
+{
+    test_pause_resume();
+    test_ignored();
+#if (SIM_STEP == 1)
+    test_resume_race();
+#endif
+
+    printf("test_overrun: flow control pauses past half, resumes at a "
+           "quarter, reports an ignored pause once\n");
+
+    return 0;
+}
+
+#else
+#error "no overrun test for this policy"
+#endif
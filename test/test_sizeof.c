@@ -0,0 +1,72 @@
+/**
+ * @file test_sizeof.c
+ * @brief The RAM taken by each port, and the flash shared by all of them
+ *
+ * Reports what `auart_t` costs per port, split into the built-in buffers,
+ * the optional frame queue and stats, and the control block left. The
+ * callbacks must stay out of it: `auart_t` only points to a const
+ * `auart_ops_t` table, shared by every port and kept in flash.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <stddef.h>
+
+#define FIELD_SIZE(type, field) sizeof(((type *)0)->field)
+
+// a pointer to a const table, a copy of the callbacks would cost RAM
+_Static_assert(_Generic(((auart_t *)0)->op,
+                        const auart_ops_t *: 1,
+                        default: 0),
+               "auart_t must point to a const auart_ops_t");
+
+// the control block without the optional parts, in pointers
+#define CONTROL_BLOCK_BUDGET (16 * sizeof(void *))
+
+int main(void)
+{
+    size_t buffers = 0;
+#if (CONFIG_AUART_TX_BUFFER_SIZE > 0)
+    buffers += FIELD_SIZE(auart_t, tx_storage);
+#endif
+#if (CONFIG_AUART_RX_BUFFER_SIZE > 0)
+    buffers += FIELD_SIZE(auart_t, rx_storage);
+#endif
+
+    size_t frames = 0;
+#if (CONFIG_AUART_RX_FRAME_QUEUE_SIZE > 0)
+    frames = FIELD_SIZE(auart_t, rx_frames);
+#endif
+
+    size_t stats = 0;
+#if (CONFIG_AUART_STATS == 1)
+    stats = FIELD_SIZE(auart_t, stats_seq) + FIELD_SIZE(auart_t, stats);
+#endif
+
+    size_t control = sizeof(auart_t) - buffers - frames - stats;
+
+    printf("test_sizeof: auart_t %zu bytes per port: control block %zu, "
+           "built-in buffers %zu, frame queue %zu, stats %zu\n",
+           sizeof(auart_t), control, buffers, frames, stats);
+    printf("test_sizeof: auart_ops_t %zu bytes shared, auart_init_t %zu "
+           "bytes on the stack, %zu-bit indices\n",
+           sizeof(auart_ops_t), sizeof(auart_init_t),
+           sizeof(auart_index_t) * 8);
+
+    CHECK(FIELD_SIZE(auart_t, op) == sizeof(void *));
+    CHECK(control <= CONTROL_BLOCK_BUDGET);
+
+    // the indices are only as wide as CONFIG_AUART_MAX_BUFFER_SIZE needs
+#if (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && (CONFIG_AUART_MAX_BUFFER_SIZE <= 0x80)
+    CHECK(sizeof(auart_index_t) == 1);
+#elif (CONFIG_AUART_MAX_BUFFER_SIZE > 0) && (CONFIG_AUART_MAX_BUFFER_SIZE <= 0x8000)
+    CHECK(sizeof(auart_index_t) == 2);
+#else
+    CHECK(sizeof(auart_index_t) == 4);
+#endif
+
+    return 0;
+}
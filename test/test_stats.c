@@ -0,0 +1,380 @@
+/**
+ * @file test_stats.c
+ * @brief The counters of `auart_get_stats()` against the simulator
+ *
+ * Built with `CONFIG_AUART_STATS`. Random traffic goes both ways, then
+ * the RX ring is lapped once, and every counter must match what the
+ * simulator and the test saw on the line: the bytes, the transfers, the
+ * interrupts, the overrun and its lost bytes, the rejected writes and the
+ * high-water marks. The dropped bytes are checked with
+ * AUART_TX_OVERWRITE_OLDEST.
+ *
+ * `auart_get_stats()` is then called from an interrupt at every
+ * instruction of a counter update, where it must return AUART_BUSY while
+ * a writer is inside and a copy between the old and new values
+ * otherwise. And it is preempted by a counter update at every instruction
+ * of its own, where the copy must be retried into one from before or from
+ * after the update, never a mix. Both are stepped like in test_claim.c
+ * (x86-64 Linux only).
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+
+#if (CONFIG_AUART_STATS != 1)
+#error "the test needs CONFIG_AUART_STATS"
+#endif
+
+#define TEST_ROUNDS 20000
+#ifndef TEST_RX_SIZE
+#define TEST_RX_SIZE 512
+#endif
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 256
+#endif
+
+#define NUM_STATS (sizeof(auart_stats_t) / sizeof(uint32_t))
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+static void start(const auart_ops_t *ops, auart_tx_policy_t policy)
+{
+    auart_init_t init = {
+        .ops = ops,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = TEST_RX_SIZE,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+        .tx_policy = policy,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+}
+
+static auart_stats_t get_stats(void)
+{
+    auart_stats_t stats;
+    CHECK(auart_get_stats(&auart, &stats) == AUART_OK);
+    return stats;
+}
+
+static void test_counters(const auart_ops_t *ops)
+{
+    start(ops, AUART_TX_PARTIAL);
+
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    long rx_read = 0;
+    long rx_high_water = 0;
+
+    long tx_written = 0;
+    long tx_rejects = 0;
+    long tx_high_water = 0;
+
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        // less than half of the ring between two reads, which read all
+        // that was announced, nothing is lost. the data waiting is
+        // measured by each interrupt.
+        int burst = rand() % (TEST_RX_SIZE / 2);
+        for (int i = 0; i < burst; i++)
+        {
+            long events = sim.rx_halfs + sim.rx_cplts;
+            sim_rx_byte(next_in++, true);
+
+            long waiting = sim.rx_bytes - rx_read;
+            if (sim.rx_halfs + sim.rx_cplts != events &&
+                waiting > rx_high_water)
+                rx_high_water = waiting;
+        }
+
+        if (rand() % 2)
+        {
+            sim_rx_idle();
+            if (sim.rx_bytes - rx_read > rx_high_water)
+                rx_high_water = sim.rx_bytes - rx_read;
+        }
+
+        int res;
+        do
+        {
+            uint8_t buffer[TEST_RX_SIZE];
+            res = auart_rx(&auart, buffer, rand() % sizeof(buffer) + 1);
+            CHECK(res >= 0);
+            for (int i = 0; i < res; i++)
+                CHECK(buffer[i] == next_out++);
+            rx_read += res;
+        } while (res > 0);
+
+        // the data waiting is measured as each write commits
+        uint8_t data[TEST_TX_SIZE / 4];
+        int32_t len = rand() % sizeof(data) + 1;
+        res = auart_tx(&auart, data, len);
+        CHECK(res >= 0 && res <= len);
+        if (res < len)
+            tx_rejects++;
+        tx_written += res;
+
+        if (res > 0 && tx_written - sim.tx_bytes > tx_high_water)
+            tx_high_water = tx_written - sim.tx_bytes;
+
+        // the dma keeps up in the first half, it falls behind in the
+        // second one, where the writes get rejected.
+        if (round < TEST_ROUNDS / 2 || rand() % 3 == 0)
+            sim_tx_complete(NULL);
+
+        if (round == TEST_ROUNDS / 2 - 1)
+        {
+            auart_stats_t stats = get_stats();
+            CHECK(stats.rx_high_water == (uint32_t)rx_high_water);
+            CHECK(stats.tx_high_water == (uint32_t)tx_high_water);
+            CHECK(stats.tx_full_rejects == (uint32_t)tx_rejects);
+            CHECK(tx_high_water < TEST_TX_SIZE);
+        }
+    }
+
+    while (sim.tx_busy)
+        sim_tx_complete(NULL);
+
+    // read what is left from the start of the ring, then lap it once
+    // without reading. the half after the lap loses half of the ring.
+    while (sim.rx_left != sim.rx_len)
+        sim_rx_byte(next_in++, true);
+    sim_rx_idle();
+    while (true)
+    {
+        uint8_t buffer[TEST_RX_SIZE];
+        int res = auart_rx(&auart, buffer, sizeof(buffer));
+        CHECK(res >= 0);
+        if (res == 0)
+            break;
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+        rx_read += res;
+    }
+    CHECK(rx_read == sim.rx_bytes);
+
+    auart_stats_t before = get_stats();
+    CHECK(before.rx_overruns == 0 && before.rx_lost_bytes == 0);
+
+    for (int i = 0; i < TEST_RX_SIZE + TEST_RX_SIZE / 2; i++)
+        sim_rx_byte(next_in++, true);
+
+    long overruns = 0;
+    while (true)
+    {
+        uint8_t buffer[TEST_RX_SIZE];
+        int res = auart_rx(&auart, buffer, sizeof(buffer));
+        if (res == AUART_OVERRUN)
+        {
+            overruns++;
+            continue;
+        }
+
+        CHECK(res >= 0);
+        if (res == 0)
+            break;
+        rx_read += res;
+    }
+    CHECK(overruns == 1);
+    rx_high_water = TEST_RX_SIZE;
+
+    auart_stats_t stats = get_stats();
+    CHECK(stats.rx_bytes == (uint32_t)sim.rx_bytes);
+    CHECK(stats.tx_bytes == (uint32_t)sim.tx_bytes);
+    CHECK(stats.tx_bytes == (uint32_t)tx_written);
+    CHECK(stats.tx_dma_starts == (uint32_t)(sim.tx_starts + sim.tx_queues));
+    CHECK(stats.idle_events == (uint32_t)sim.idles);
+    CHECK(stats.rx_half_events == (uint32_t)sim.rx_halfs);
+    CHECK(stats.rx_cplt_events == (uint32_t)sim.rx_cplts);
+    CHECK(stats.rx_overruns == (uint32_t)overruns);
+    CHECK(stats.rx_lost_bytes == (uint32_t)(sim.rx_bytes - rx_read));
+    CHECK(stats.rx_lost_bytes == TEST_RX_SIZE / 2);
+    CHECK(stats.tx_full_rejects == (uint32_t)tx_rejects);
+    CHECK(stats.tx_dropped_bytes == 0);
+    CHECK(stats.rx_high_water == (uint32_t)rx_high_water);
+    CHECK(stats.tx_high_water == (uint32_t)tx_high_water);
+
+    printf("test_stats: %-8s %u bytes in, %u out in %u transfers, "
+           "%u rejects, high water %u/%u, all matching\n",
+           ops->dma_tx_queue ? "queue" : "no queue",
+           (unsigned)stats.rx_bytes, (unsigned)stats.tx_bytes,
+           (unsigned)stats.tx_dma_starts, (unsigned)stats.tx_full_rejects,
+           (unsigned)stats.rx_high_water, (unsigned)stats.tx_high_water);
+}
+
+static void test_dropped(void)
+{
+    start(&sim_ops, AUART_TX_OVERWRITE_OLDEST);
+
+    // the dma holds the first write, the rest overwrites itself
+    uint8_t data[TEST_TX_SIZE];
+    memset(data, 0, sizeof(data));
+
+    long written = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        int32_t len = TEST_TX_SIZE / 4 + i;
+        CHECK(auart_tx(&auart, data, len) == len);
+        written += len;
+    }
+
+    while (sim.tx_busy)
+        sim_tx_complete(NULL);
+
+    auart_stats_t stats = get_stats();
+    CHECK(stats.tx_bytes == (uint32_t)sim.tx_bytes);
+    CHECK(stats.tx_dropped_bytes == (uint32_t)(written - sim.tx_bytes));
+    CHECK(stats.tx_dropped_bytes > 0);
+}
+
+#if (SIM_STEP == 1)
+static void check_between(const auart_stats_t *copy,
+                          const auart_stats_t *before,
+                          const auart_stats_t *after)
+{
+    const uint32_t *c = (const uint32_t *)copy;
+    const uint32_t *b = (const uint32_t *)before;
+    const uint32_t *a = (const uint32_t *)after;
+
+    for (size_t i = 0; i < NUM_STATS; i++)
+        CHECK(c[i] >= b[i] && c[i] <= a[i]);
+}
+
+static volatile long step;
+static long fire_step;
+static auart_stats_t copies[4096];
+static volatile long num_copies;
+static volatile long num_busy;
+
+// the reader in an interrupt, the writers may be inside
+static void on_step_read(void)
+{
+    step++;
+
+    bool is_inside = (auart.stats_seq & 0xFFFF) != 0;
+
+    auart_stats_t copy;
+    int res = auart_get_stats(&auart, &copy);
+    if (is_inside)
+    {
+        CHECK(res == AUART_BUSY);
+        num_busy++;
+        return;
+    }
+
+    CHECK(res == AUART_OK);
+    CHECK(num_copies < (long)(sizeof(copies) / sizeof(copies[0])));
+    copies[num_copies++] = copy;
+}
+
+// an idle interrupt preempting the reader, with bytes to announce
+static void on_step_write(void)
+{
+    if (++step == fire_step)
+        sim_rx_idle();
+}
+
+static void test_preempt_writer(void)
+{
+    start(&sim_ops, AUART_TX_PARTIAL);
+
+    for (int i = 0; i < 10; i++)
+        sim_rx_byte((uint8_t)i, false);
+    auart_stats_t before = get_stats();
+
+    // the first call resolves the lazy bindings, keep it unstepped
+    auart_stats_t copy;
+    auart_get_stats(&auart, &copy);
+
+    step = 0;
+    num_copies = 0;
+    num_busy = 0;
+    sim_step_begin(on_step_read);
+    sim_rx_idle();
+    sim_step_end();
+
+    auart_stats_t after = get_stats();
+    CHECK(after.idle_events == before.idle_events + 1);
+    CHECK(after.rx_bytes == before.rx_bytes + 10);
+
+    for (long i = 0; i < num_copies; i++)
+        check_between(&copies[i], &before, &after);
+
+    CHECK(num_busy > 0 && num_copies > 0);
+
+    printf("test_stats: %ld reads from an interrupt inside the idle "
+           "callback, %ld busy, %ld between the old and new counters\n",
+           step, num_busy, num_copies);
+}
+
+// returns false once `fire_step` is past the end of the stepped call
+static bool run_preempt_reader(long at, long *num_after)
+{
+    start(&sim_ops, AUART_TX_PARTIAL);
+
+    for (int i = 0; i < 10; i++)
+        sim_rx_byte((uint8_t)i, false);
+    auart_stats_t before = get_stats();
+
+    step = 0;
+    fire_step = at;
+
+    auart_stats_t copy;
+    sim_step_begin(on_step_write);
+    int res = auart_get_stats(&auart, &copy);
+    sim_step_end();
+
+    bool is_fired = at > 0 && step >= at;
+    if (!is_fired)
+        sim_rx_idle();
+
+    auart_stats_t after = get_stats();
+    CHECK(after.rx_bytes == before.rx_bytes + 10);
+
+    CHECK(res == AUART_OK);
+    if (memcmp(&copy, &after, sizeof(copy)) == 0)
+        (*num_after)++;
+    else
+        CHECK(memcmp(&copy, &before, sizeof(copy)) == 0);
+
+    return is_fired;
+}
+
+static void test_preempt_reader(void)
+{
+    long num_after = 0;
+
+    // the first call resolves the lazy bindings, keep it unstepped
+    run_preempt_reader(0, &num_after);
+    num_after = 0;
+
+    long at = 1;
+    while (run_preempt_reader(at, &num_after))
+        at++;
+
+    CHECK(num_after > 0 && num_after < at - 1);
+
+    printf("test_stats: %ld reads preempted by the idle callback, %ld "
+           "copies from after, the rest from before, none mixed\n",
+           at - 1, num_after);
+}
+#endif
+
+int main(void)
+{
+    test_counters(&sim_ops);
+    test_counters(&sim_ops_queue);
+    test_dropped();
+#if (SIM_STEP == 1)
+    test_preempt_writer();
+    test_preempt_reader();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file test_tick.c
+ * @brief Bytes received without an interrupt, announced by `auart_tick()`
+ *
+ * A tick that finds the DMA counter where the tail already is must leave
+ * the tail alone and notify nobody. Bytes that arrive without an IDLE,
+ * half or complete interrupt, up to the reload of the counter, must be
+ * announced by the next tick that looks at the DMA.
+ *
+ * With CONFIG_AUART_TICK_LATENCY_MS the tick is called every millisecond
+ * of `sim.tick_ms` and only looks once per latency period. The bytes are
+ * then announced no later than that.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#ifndef TEST_RX_SIZE
+#define TEST_RX_SIZE 128
+#endif
+
+static auart_t auart;
+static uint8_t rx_buffer[TEST_RX_SIZE];
+
+static uint8_t next_in;
+static uint8_t next_out;
+
+static void receive(int len)
+{
+    for (int i = 0; i < len; i++)
+        sim_rx_byte(next_in++, false);
+}
+
+static void read_all(void)
+{
+    uint8_t buffer[TEST_RX_SIZE];
+    int res;
+    while ((res = auart_rx(&auart, buffer, sizeof(buffer))) > 0)
+    {
+        for (int i = 0; i < res; i++)
+            CHECK(buffer[i] == next_out++);
+    }
+
+    CHECK(res == 0);
+    CHECK(next_out == next_in);
+}
+
+// the tick at the next millisecond
+static void tick(void)
+{
+    sim.tick_ms++;
+    CHECK(auart_tick(&auart) == AUART_OK);
+}
+
+// ticks until the tail moves, returns how many
+static int ticks_to_announce(void)
+{
+    uint32_t tail = auart.rx_tail;
+    long notifies = sim.notifies;
+
+    int ticks = 0;
+    while (auart.rx_tail == tail)
+    {
+        CHECK(sim.notifies == notifies);
+        CHECK(ticks++ <= CONFIG_AUART_TICK_LATENCY_MS);
+        tick();
+    }
+
+    CHECK(sim.notifies == notifies + 1);
+    return ticks;
+}
+
+// a look at an unchanged counter does nothing
+static void check_still(void)
+{
+    uint32_t tail = auart.rx_tail;
+    long notifies = sim.notifies;
+
+    for (int i = 0; i < CONFIG_AUART_TICK_LATENCY_MS * 3 + 3; i++)
+        tick();
+
+    CHECK(auart.rx_tail == tail);
+    CHECK(sim.notifies == notifies);
+}
+
+int main(void)
+{
+    auart_init_t init = {
+        .dir = AUART_DIR_RX_ONLY,
+        .rx_buffer = rx_buffer,
+        .rx_buffer_size = TEST_RX_SIZE,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    // nothing received yet
+    check_still();
+
+    // a few bytes, the line never goes idle
+    receive(10);
+    ticks_to_announce();
+    check_still();
+    read_all();
+    check_still();
+
+    // the bytes announced by an interrupt are not announced again
+    receive(5);
+    sim_rx_idle();
+    read_all();
+    check_still();
+
+    // up to the reload of the counter, which reads 0 again
+    receive(sim.rx_left);
+    CHECK(sim.rx_left == sim.rx_len);
+    ticks_to_announce();
+    check_still();
+    read_all();
+
+    // bytes arriving right after each look, for a few laps. the next look
+    // is a whole latency period later, and not any sooner.
+    const int period = CONFIG_AUART_TICK_LATENCY_MS > 0
+                           ? CONFIG_AUART_TICK_LATENCY_MS
+                           : 1;
+    receive(1);
+    ticks_to_announce();
+    read_all();
+
+    for (int i = 0; i < TEST_RX_SIZE * 4 / 7; i++)
+    {
+        receive(7);
+        CHECK(ticks_to_announce() == period);
+        read_all();
+    }
+
+    check_still();
+    CHECK(sim.rx_starts == 1);
+
+    printf("test_tick: %d ms latency, announced within %d ticks, none on "
+           "an unchanged counter\n",
+           CONFIG_AUART_TICK_LATENCY_MS, period);
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * @file test_tx_policy.c
+ * @brief The TX policies against a complete interrupt firing at any time
+ *
+ * A timer signal finishes the running transfer and calls
+ * `auart_tx_cplt_callback()`, so it preempts `auart_tx()` anywhere, in
+ * particular while AUART_TX_OVERWRITE_OLDEST takes its snapshot of the
+ * head and of the sizes owned by the DMA. Each policy runs with and
+ * without `dma_tx_queue`.
+ *
+ * PARTIAL, ALL_OR_NOTHING and BLOCK must send exactly the accepted bytes,
+ * OVERWRITE_OLDEST must send a subsequence of the written bytes and count
+ * every dropped byte. Without CONFIG_AUART_USE_TIME_API, BLOCK takes no
+ * timeout but 0 and AUART_WAIT_FOREVER.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#if (CONFIG_AUART_STATS != 1)
+#error "the dropped bytes are counted by the stats"
+#endif
+
+#define TEST_BYTES 1000000L
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 512
+#endif
+
+static auart_t auart;
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+static uint8_t written[TEST_BYTES + 2048];
+static uint8_t line[TEST_BYTES + 2048];
+static volatile long sent;
+
+static void on_timer(int sig)
+{
+    (void)sig;
+    sent += sim_tx_complete(line + sent);
+}
+
+static void run(auart_tx_policy_t policy, const auart_ops_t *ops)
+{
+    static const char *const names[] = {
+        [AUART_TX_PARTIAL] = "partial",
+        [AUART_TX_ALL_OR_NOTHING] = "all or nothing",
+        [AUART_TX_OVERWRITE_OLDEST] = "overwrite oldest",
+        [AUART_TX_BLOCK] = "block",
+    };
+
+    auart_init_t init = {
+        .ops = ops,
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+        .tx_policy = policy,
+        .tx_timeout_ms = AUART_WAIT_FOREVER,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    sent = 0;
+    long attempted = 0;
+    long accepted = 0;
+    long num_written = 0;
+    uint32_t seq = 0;
+
+    srand(6);
+
+    struct itimerval timer = {{0, 7}, {0, 7}};
+    CHECK(setitimer(ITIMER_REAL, &timer, NULL) == 0);
+
+    while (attempted < TEST_BYTES)
+    {
+        // larger than the buffer with OVERWRITE_OLDEST, only the end is kept
+        uint8_t data[TEST_TX_SIZE * 2];
+        int32_t len = rand() % (policy == AUART_TX_OVERWRITE_OLDEST
+                                    ? (int)sizeof(data)
+                                    : TEST_TX_SIZE / 2);
+
+        for (int32_t i = 0; i < len; i++)
+        {
+            // not periodic, a dropped byte cannot be mistaken for a later one
+            data[i] = (uint8_t)((seq + i) * 7 + (seq + i) / 251);
+            written[num_written + i] = data[i];
+        }
+
+        int res = auart_tx(&auart, data, len);
+        CHECK(res >= 0 && res <= len);
+
+        if (policy == AUART_TX_ALL_OR_NOTHING)
+            CHECK(res == 0 || res == len);
+        if (policy == AUART_TX_BLOCK)
+            CHECK(res == len);
+
+        // the rejected bytes are written again by the next call
+        int32_t size_kept = policy == AUART_TX_OVERWRITE_OLDEST ? len : res;
+        seq += size_kept;
+        num_written += size_kept;
+
+        attempted += len;
+        accepted += res;
+    }
+
+    CHECK(auart_tx_flush(&auart) == AUART_OK);
+
+    struct itimerval stop = {{0, 0}, {0, 0}};
+    CHECK(setitimer(ITIMER_REAL, &stop, NULL) == 0);
+    on_timer(SIGALRM);
+    CHECK(!sim.tx_busy);
+
+    auart_stats_t stats;
+    CHECK(auart_get_stats(&auart, &stats) == AUART_OK);
+
+    if (policy != AUART_TX_OVERWRITE_OLDEST)
+    {
+        CHECK(sent == num_written);
+        CHECK(memcmp(line, written, sent) == 0);
+    }
+    else
+    {
+        long j = 0;
+        for (long i = 0; i < sent; i++, j++)
+        {
+            while (j < num_written && written[j] != line[i])
+                j++;
+            CHECK(j < num_written);
+        }
+
+        CHECK(num_written - sent == (long)stats.tx_dropped_bytes);
+    }
+
+    printf("test_tx_policy: %-16s %-8s %ld sent, %ld accepted of %ld, "
+           "%u dropped, %u queued\n",
+           names[policy], ops->dma_tx_queue ? "queue" : "no queue",
+           (long)sent, accepted, attempted,
+           (unsigned)stats.tx_dropped_bytes, (unsigned)sim.tx_queues);
+}
+
+// a finite wait needs the clock
+static void test_block_timeout(void)
+{
+    const uint32_t timeouts[] = {0, 10, AUART_WAIT_FOREVER};
+
+    for (size_t i = 0; i < sizeof(timeouts) / sizeof(timeouts[0]); i++)
+    {
+        auart_init_t init = {
+            .dir = AUART_DIR_TX_ONLY,
+            .tx_buffer = tx_buffer,
+            .tx_buffer_size = TEST_TX_SIZE,
+            .tx_policy = AUART_TX_BLOCK,
+            .tx_timeout_ms = timeouts[i],
+        };
+
+        int expected = AUART_OK;
+#if (CONFIG_AUART_USE_TIME_API != 1)
+        if (timeouts[i] != 0 && timeouts[i] != AUART_WAIT_FOREVER)
+            expected = AUART_INVALID_ARGUMENT;
+#endif
+        CHECK(sim_init(&auart, &init) == expected);
+
+        // the other policies do not wait
+        init.tx_policy = AUART_TX_PARTIAL;
+        CHECK(sim_init(&auart, &init) == AUART_OK);
+    }
+}
+
+int main(void)
+{
+    test_block_timeout();
+
+    signal(SIGALRM, on_timer);
+
+    const auart_tx_policy_t policies[] = {
+        AUART_TX_PARTIAL,
+        AUART_TX_ALL_OR_NOTHING,
+        AUART_TX_OVERWRITE_OLDEST,
+        AUART_TX_BLOCK,
+    };
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++)
+    {
+        run(policies[i], &sim_ops);
+        run(policies[i], &sim_ops_queue);
+    }
+
+    return 0;
+}
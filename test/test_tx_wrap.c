@@ -0,0 +1,115 @@
+/**
+ * @file test_tx_wrap.c
+ * @brief Idle time on the line where the TX data wraps around the ring
+ *
+ * The line sends one byte per tick. A transfer queued with `dma_tx_queue`
+ * follows the running one on the same tick, a transfer started from
+ * `auart_tx_cplt_callback()` waits for the interrupt round trip first.
+ * Bursts written onto an idle DMA must never leave the line idle at the
+ * wrap, bursts written while it is busy may, since the wrapped segment
+ * can only be queued once the running transfer is done. The bytes must
+ * come out in order either way.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "sim.h"
+
+#include <string.h>
+
+#ifndef TEST_TX_SIZE
+#define TEST_TX_SIZE 256
+#endif
+
+// the interrupt round trip, in byte times on the line
+#define IRQ_ROUND_TRIP 2
+
+#define TEST_BYTES 2000000L
+
+static auart_t auart;
+static uint8_t tx_buffer[TEST_TX_SIZE];
+
+typedef struct
+{
+    long wraps;
+    long idle_ticks;
+} wrap_result_t;
+
+static wrap_result_t run(const auart_ops_t *ops, bool onto_idle)
+{
+    auart_init_t init = {
+        .ops = ops,
+        .dir = AUART_DIR_TX_ONLY,
+        .tx_buffer = tx_buffer,
+        .tx_buffer_size = TEST_TX_SIZE,
+    };
+    CHECK(sim_init(&auart, &init) == AUART_OK);
+
+    wrap_result_t result = {0, 0};
+    uint8_t next_in = 0;
+    uint8_t next_out = 0;
+    long sent = 0;
+
+    srand(2);
+
+    while (sent < TEST_BYTES)
+    {
+        // a burst
+        uint8_t data[TEST_TX_SIZE];
+        int32_t len = rand() % TEST_TX_SIZE + 1;
+        for (int32_t i = 0; i < len; i++)
+            data[i] = (uint8_t)(next_in + i);
+
+        int res = auart_tx(&auart, data, len);
+        CHECK(res >= 0);
+        next_in += res;
+
+        int transfers = onto_idle || rand() % 2 ? 1000 : 1;
+        while (transfers-- > 0 && sim.tx_busy)
+        {
+            const uint8_t *end = sim.tx_src + sim.tx_len;
+            bool is_queued = sim.tx_queued_len != 0;
+
+            uint8_t line[TEST_TX_SIZE];
+            int32_t n = sim_tx_complete(line);
+            for (int32_t i = 0; i < n; i++)
+                CHECK(line[i] == next_out++);
+            sent += n;
+
+            // the next transfer starts at the beginning of the ring
+            if (end == tx_buffer + TEST_TX_SIZE && sim.tx_busy)
+            {
+                result.wraps++;
+                if (!is_queued)
+                    result.idle_ticks += IRQ_ROUND_TRIP;
+            }
+        }
+    }
+
+    return result;
+}
+
+int main(void)
+{
+    static const char *const names[2] = {"onto busy dma", "onto idle dma"};
+
+    for (int onto_idle = 1; onto_idle >= 0; onto_idle--)
+    {
+        wrap_result_t irq = run(&sim_ops, onto_idle);
+        CHECK(sim.tx_queues == 0);
+
+        wrap_result_t queued = run(&sim_ops_queue, onto_idle);
+        CHECK(queued.wraps > 1000);
+
+        printf("test_tx_wrap: %s, idle byte times/wrap: %.2f from irq, "
+               "%.2f with dma_tx_queue\n",
+               names[onto_idle], (double)irq.idle_ticks / irq.wraps,
+               (double)queued.idle_ticks / queued.wraps);
+
+        if (onto_idle)
+            CHECK(queued.idle_ticks == 0);
+    }
+
+    return 0;
+}